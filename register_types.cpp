@@ -32,6 +32,7 @@
 
 // #ifdef TOOLS_ENABLED
 #include "editor/editor_node.h"
+#include "editor/plugins/node_3d_editor_plugin.h"
 
 #include "modules/gltf/extensions/gltf_document_extension.h"
 #include "modules/gltf/gltf_document.h"
@@ -39,7 +40,24 @@
 
 #include "register_types.h"
 
+#include "core/io/json.h"
+#include "core/os/os.h"
+#include "core/templates/hashfuncs.h"
+#include "main/performance.h"
+#include "scene/3d/camera_3d.h"
+#include "scene/3d/visible_on_screen_notifier_3d.h"
+#include "scene/main/viewport.h"
+
+#if !defined(REAL_T_IS_DOUBLE) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define VRM_SPRING_BONE_SIMD_SSE2
+#include <emmintrin.h>
+#elif !defined(REAL_T_IS_DOUBLE) && (defined(__aarch64__) || defined(_M_ARM64))
+#define VRM_SPRING_BONE_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
 VRMEditorPlugin *import_vrm = nullptr;
+VRMSpringBoneServer *spring_bone_server = nullptr;
 
 static void _editor_init() {
 	import_vrm = memnew(VRMEditorPlugin);
@@ -56,67 +74,80 @@ void initialize_vrm_module(ModuleInitializationLevel p_level) {
 		GDREGISTER_CLASS(VRMEditorPlugin);
 		GDREGISTER_CLASS(VRMTopLevel);
 		GDREGISTER_CLASS(VRMMeta);
+		GDREGISTER_CLASS(VRMSpringBoneServer);
+		GDREGISTER_CLASS(VRMSpringBoneBenchmark);
+		GDREGISTER_CLASS(VRMSecondary);
+		spring_bone_server = memnew(VRMSpringBoneServer);
+		Engine::get_singleton()->add_singleton(Engine::Singleton("VRMSpringBoneServer", VRMSpringBoneServer::get_singleton()));
 		EditorNode::add_init_callback(_editor_init);
 	}
 }
 
 void uninitialize_vrm_module(ModuleInitializationLevel p_level) {
+	if (p_level == MODULE_INITIALIZATION_LEVEL_SCENE) {
+		if (spring_bone_server) {
+			spring_bone_server->unregister_monitors();
+		}
+	}
+	if (p_level == MODULE_INITIALIZATION_LEVEL_SERVERS) {
+		if (spring_bone_server) {
+			memdelete(spring_bone_server);
+			spring_bone_server = nullptr;
+		}
+	}
 }
 
 void SecondaryGizmo::draw_spring_bones(Color color) {
 	set_material_override(m);
-	// Spring bones
-	Array spring_bones_internal_array = secondary_node->get("spring_bones_internal");
-	for (int32_t spring_bone_i = 0; spring_bone_i < spring_bones_internal_array.size(); spring_bone_i++) {
-		VRMSpringBone *spring_bone = cast_to<VRMSpringBone>(spring_bones_internal_array[spring_bone_i]);
-		Ref<ImmediateMesh> immediate_mesh = get_mesh();
-		if (immediate_mesh.is_null()) {
+	// Spring bones, from the written back tails: async avatars may be solving.
+	const VRMSpringBoneServer::Avatar *avatar = VRMSpringBoneServer::get_singleton()->avatar_get(secondary_node->avatar);
+	if (!avatar) {
+		return;
+	}
+	const VRMSpringBoneJoints &joints = avatar->joints;
+	const bool is_editor = Engine::get_singleton()->is_editor_hint();
+	for (int32_t spring_bone_i = 0; spring_bone_i < avatar->spring_bones.size(); spring_bone_i++) {
+		VRMSpringBone *spring_bone = avatar->spring_bones[spring_bone_i].ptr();
+		// Maps the simulated tails into skeleton space, built once per spring bone.
+		Skeleton3D *tail_sk = is_editor ? Object::cast_to<Skeleton3D>(secondary_node->get_node_or_null(spring_bone->skeleton)) : spring_bone->skel;
+		if (!tail_sk) {
 			continue;
 		}
-		immediate_mesh->surface_begin(Mesh::PRIMITIVE_LINES);
-		for (int32_t verlet_i = 0; verlet_i < spring_bone->verlets.size(); verlet_i++) {
-			Ref<VRMSpringBoneLogic> v = spring_bone->verlets[verlet_i];
-			if (v.is_null()) {
-				continue;
-			}
-			Transform3D s_tr;
-			Skeleton3D *s_sk = spring_bone->skel;
-			if (Engine::get_singleton()->is_editor_hint() && s_sk) {
-				s_sk = cast_to<Skeleton3D>(secondary_node->get_node_or_null(spring_bone->skeleton));
-				if (v->bone_idx != -1) {
-					s_tr = s_sk->get_bone_global_pose(v->bone_idx);
+		const Transform3D tail_to_skeleton = tail_sk->get_relative_transform(tail_sk->get_parent()).affine_inverse();
+		const uint32_t chain_end = spring_bone->chain_offset + spring_bone->chain_count;
+		for (uint32_t chain_i = spring_bone->chain_offset; chain_i < chain_end; chain_i++) {
+			const VRMSpringBoneChain &chain = joints.chains[chain_i];
+			// Bounds the whole chain before drawing any of it.
+			chain_poses.clear();
+			chain_tails.clear();
+			AABB chain_bounds;
+			for (uint32_t joint_i = chain.joint_begin; joint_i < chain.joint_end; joint_i++) {
+				const int32_t bone_idx = joints.bone_idx[joint_i];
+				Transform3D s_tr;
+				if (!is_editor) {
+					s_tr = tail_sk->get_bone_global_pose_no_override(bone_idx);
+				} else if (bone_idx != -1) {
+					s_tr = tail_sk->get_bone_global_pose(bone_idx);
+				}
+				const Vector3 tail = tail_to_skeleton.xform(avatar->written_tails.get(joint_i));
+				if (joint_i == chain.joint_begin) {
+					chain_bounds.position = s_tr.origin;
 				} else {
-					s_tr = spring_bone->skel->get_bone_global_pose_no_override(v->bone_idx);
+					chain_bounds.expand_to(s_tr.origin);
 				}
-				draw_line(
-						s_tr.origin,
-						VRMTopLevel::inv_transform_point(s_sk->get_relative_transform(s_sk->get_parent()), v->current_tail),
-						color);
+				chain_bounds.expand_to(tail);
+				chain_poses.push_back(s_tr);
+				chain_tails.push_back(tail);
 			}
-		}
-		immediate_mesh->surface_end();
-		for (int32_t verlet_i = 0; verlet_i < spring_bone->verlets.size(); verlet_i++) {
-			Ref<VRMSpringBoneLogic> v = spring_bone->verlets[verlet_i];
-			if (v.is_null()) {
+			if (!_is_visible(chain_bounds.get_center(), chain_bounds.size.length() * 0.5 + spring_bone->hit_radius)) {
 				continue;
 			}
-			immediate_mesh->surface_begin(Mesh::PRIMITIVE_LINE_STRIP);
-			Transform3D s_tr;
-			Skeleton3D *s_sk = spring_bone->skel;
-			if (Engine::get_singleton()->is_editor_hint()) {
-				s_sk = cast_to<Skeleton3D>(secondary_node->get_node_or_null(spring_bone->skeleton));
-				if (v->bone_idx != -1) {
-					s_tr = s_sk->get_bone_global_pose(v->bone_idx);
+			for (uint32_t pose_i = 0; pose_i < chain_poses.size(); pose_i++) {
+				if (is_editor && spring_bone->skel) {
+					draw_line(chain_poses[pose_i].origin, chain_tails[pose_i], color);
 				}
-			} else {
-				s_tr = spring_bone->skel->get_bone_global_pose_no_override(v->bone_idx);
+				draw_sphere(chain_poses[pose_i].basis, chain_tails[pose_i], spring_bone->hit_radius, color);
 			}
-			draw_sphere(
-					s_tr.basis,
-					VRMTopLevel::inv_transform_point(s_sk->get_relative_transform(s_sk->get_parent()), v->current_tail),
-					spring_bone->hit_radius,
-					color);
-			immediate_mesh->surface_end();
 		}
 	}
 }
@@ -217,508 +248,3070 @@ void VRMTopLevel::set_vrm_meta(Ref<VRMMeta> p_meta) {
 	vrm_meta = p_meta;
 }
 
-bool VRMTopLevel::get_update_secondary_fixed() {
-	return update_secondary_fixed;
+bool VRMTopLevel::get_update_secondary_fixed() {
+	return update_secondary_fixed;
+}
+
+void VRMTopLevel::set_update_secondary_fixed(bool p_fixed) {
+	update_secondary_fixed = p_fixed;
+}
+
+bool VRMTopLevel::get_update_in_editor() {
+	return update_in_editor;
+}
+
+void VRMTopLevel::set_update_in_editor(bool p_update) {
+	update_in_editor = p_update;
+}
+
+bool VRMTopLevel::get_gizmo_spring_bone() {
+	return gizmo_spring_bone;
+}
+
+void VRMTopLevel::set_gizmo_spring_bone(bool p_update) {
+	gizmo_spring_bone = p_update;
+}
+
+Color VRMTopLevel::get_gizmo_spring_bone_color() {
+	return gizmo_spring_bone_color;
+}
+
+VRMTopLevel::SpringBoneUpdateMode VRMTopLevel::get_spring_bone_update_mode() {
+	return spring_bone_update_mode;
+}
+
+void VRMTopLevel::set_spring_bone_update_mode(SpringBoneUpdateMode p_mode) {
+	spring_bone_update_mode = p_mode;
+}
+
+int VRMTopLevel::get_spring_bone_parallel_min_joints() {
+	return spring_bone_parallel_min_joints;
+}
+
+void VRMTopLevel::set_spring_bone_parallel_min_joints(int p_min_joints) {
+	spring_bone_parallel_min_joints = MAX(p_min_joints, 0);
+}
+
+int VRMTopLevel::get_spring_bone_fixed_step_rate() {
+	return spring_bone_fixed_step_rate;
+}
+
+void VRMTopLevel::set_spring_bone_fixed_step_rate(int p_step_rate) {
+	spring_bone_fixed_step_rate = MAX(p_step_rate, 0);
+}
+
+int VRMTopLevel::get_spring_bone_max_substeps() {
+	return spring_bone_max_substeps;
+}
+
+void VRMTopLevel::set_spring_bone_max_substeps(int p_max_substeps) {
+	spring_bone_max_substeps = MAX(p_max_substeps, 1);
+}
+
+bool VRMTopLevel::get_spring_bone_lod_enabled() {
+	return spring_bone_lod_enabled;
+}
+
+void VRMTopLevel::set_spring_bone_lod_enabled(bool p_enabled) {
+	spring_bone_lod_enabled = p_enabled;
+}
+
+Vector4 VRMTopLevel::get_spring_bone_lod_distances() {
+	return spring_bone_lod_distances;
+}
+
+void VRMTopLevel::set_spring_bone_lod_distances(Vector4 p_distances) {
+	spring_bone_lod_distances = p_distances;
+}
+
+real_t VRMTopLevel::get_spring_bone_lod_hysteresis() {
+	return spring_bone_lod_hysteresis;
+}
+
+void VRMTopLevel::set_spring_bone_lod_hysteresis(real_t p_hysteresis) {
+	spring_bone_lod_hysteresis = MAX(p_hysteresis, real_t(0.0));
+}
+
+real_t VRMTopLevel::get_spring_bone_lod_blend_time() {
+	return spring_bone_lod_blend_time;
+}
+
+void VRMTopLevel::set_spring_bone_lod_blend_time(real_t p_blend_time) {
+	spring_bone_lod_blend_time = MAX(p_blend_time, real_t(0.0));
+}
+
+NodePath VRMTopLevel::get_spring_bone_lod_visibility_notifier() {
+	return spring_bone_lod_visibility_notifier;
+}
+
+void VRMTopLevel::set_spring_bone_lod_visibility_notifier(NodePath p_path) {
+	spring_bone_lod_visibility_notifier = p_path;
+}
+
+int VRMTopLevel::get_spring_bone_sleep_frames() {
+	return spring_bone_sleep_frames;
+}
+
+void VRMTopLevel::set_spring_bone_sleep_frames(int p_frames) {
+	spring_bone_sleep_frames = MAX(p_frames, 0);
+}
+
+real_t VRMTopLevel::get_spring_bone_sleep_threshold() {
+	return spring_bone_sleep_threshold;
+}
+
+void VRMTopLevel::set_spring_bone_sleep_threshold(real_t p_threshold) {
+	spring_bone_sleep_threshold = MAX(p_threshold, real_t(0.0));
+}
+
+bool VRMTopLevel::get_spring_bone_interaction_enabled() {
+	return spring_bone_interaction_enabled;
+}
+
+void VRMTopLevel::set_spring_bone_interaction_enabled(bool p_enabled) {
+	spring_bone_interaction_enabled = p_enabled;
+}
+
+bool VRMTopLevel::get_gizmo_spring_bone_selected_only() {
+	return gizmo_spring_bone_selected_only;
+}
+
+void VRMTopLevel::set_gizmo_spring_bone_selected_only(bool p_selected_only) {
+	gizmo_spring_bone_selected_only = p_selected_only;
+}
+
+int VRMTopLevel::get_gizmo_spring_bone_redraw_rate() {
+	return gizmo_spring_bone_redraw_rate;
+}
+
+void VRMTopLevel::set_gizmo_spring_bone_redraw_rate(int p_rate) {
+	gizmo_spring_bone_redraw_rate = MAX(p_rate, 0);
+}
+
+real_t VRMTopLevel::get_gizmo_spring_bone_redraw_threshold() {
+	return gizmo_spring_bone_redraw_threshold;
+}
+
+void VRMTopLevel::set_gizmo_spring_bone_redraw_threshold(real_t p_threshold) {
+	gizmo_spring_bone_redraw_threshold = MAX(p_threshold, real_t(0.0));
+}
+
+void VRMTopLevel::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("get_vrm_skeleton"), &VRMTopLevel::get_vrm_skeleton);
+	ClassDB::bind_method(D_METHOD("set_vrm_skeleton"), &VRMTopLevel::set_vrm_skeleton);
+	ClassDB::bind_method(D_METHOD("get_vrm_animplayer"), &VRMTopLevel::get_vrm_animplayer);
+	ClassDB::bind_method(D_METHOD("set_vrm_animplayer"), &VRMTopLevel::set_vrm_animplayer);
+	ClassDB::bind_method(D_METHOD("get_vrm_secondary"), &VRMTopLevel::get_vrm_secondary);
+	ClassDB::bind_method(D_METHOD("set_vrm_secondary"), &VRMTopLevel::set_vrm_secondary);
+	ClassDB::bind_method(D_METHOD("get_vrm_meta"), &VRMTopLevel::get_vrm_meta);
+	ClassDB::bind_method(D_METHOD("set_vrm_meta"), &VRMTopLevel::set_vrm_meta);
+	ClassDB::bind_method(D_METHOD("get_update_secondary_fixed"), &VRMTopLevel::get_update_secondary_fixed);
+	ClassDB::bind_method(D_METHOD("set_update_secondary_fixed"), &VRMTopLevel::set_update_secondary_fixed);
+	ClassDB::bind_method(D_METHOD("get_update_in_editor"), &VRMTopLevel::get_update_in_editor);
+	ClassDB::bind_method(D_METHOD("set_update_in_editor"), &VRMTopLevel::set_update_in_editor);
+	ClassDB::bind_method(D_METHOD("get_gizmo_spring_bone_color"), &VRMTopLevel::get_gizmo_spring_bone_color);
+	ClassDB::bind_method(D_METHOD("set_gizmo_spring_bone_color"), &VRMTopLevel::set_gizmo_spring_bone_color);
+	ClassDB::bind_method(D_METHOD("get_gizmo_spring_bone_selected_only"), &VRMTopLevel::get_gizmo_spring_bone_selected_only);
+	ClassDB::bind_method(D_METHOD("set_gizmo_spring_bone_selected_only", "selected_only"), &VRMTopLevel::set_gizmo_spring_bone_selected_only);
+	ClassDB::bind_method(D_METHOD("get_gizmo_spring_bone_redraw_rate"), &VRMTopLevel::get_gizmo_spring_bone_redraw_rate);
+	ClassDB::bind_method(D_METHOD("set_gizmo_spring_bone_redraw_rate", "rate"), &VRMTopLevel::set_gizmo_spring_bone_redraw_rate);
+	ClassDB::bind_method(D_METHOD("get_gizmo_spring_bone_redraw_threshold"), &VRMTopLevel::get_gizmo_spring_bone_redraw_threshold);
+	ClassDB::bind_method(D_METHOD("set_gizmo_spring_bone_redraw_threshold", "threshold"), &VRMTopLevel::set_gizmo_spring_bone_redraw_threshold);
+	ClassDB::bind_method(D_METHOD("get_spring_bone_update_mode"), &VRMTopLevel::get_spring_bone_update_mode);
+	ClassDB::bind_method(D_METHOD("set_spring_bone_update_mode", "mode"), &VRMTopLevel::set_spring_bone_update_mode);
+	ClassDB::bind_method(D_METHOD("get_spring_bone_parallel_min_joints"), &VRMTopLevel::get_spring_bone_parallel_min_joints);
+	ClassDB::bind_method(D_METHOD("set_spring_bone_parallel_min_joints", "min_joints"), &VRMTopLevel::set_spring_bone_parallel_min_joints);
+	ClassDB::bind_method(D_METHOD("get_spring_bone_fixed_step_rate"), &VRMTopLevel::get_spring_bone_fixed_step_rate);
+	ClassDB::bind_method(D_METHOD("set_spring_bone_fixed_step_rate", "step_rate"), &VRMTopLevel::set_spring_bone_fixed_step_rate);
+	ClassDB::bind_method(D_METHOD("get_spring_bone_max_substeps"), &VRMTopLevel::get_spring_bone_max_substeps);
+	ClassDB::bind_method(D_METHOD("set_spring_bone_max_substeps", "max_substeps"), &VRMTopLevel::set_spring_bone_max_substeps);
+	ClassDB::bind_method(D_METHOD("get_spring_bone_lod_enabled"), &VRMTopLevel::get_spring_bone_lod_enabled);
+	ClassDB::bind_method(D_METHOD("set_spring_bone_lod_enabled", "enabled"), &VRMTopLevel::set_spring_bone_lod_enabled);
+	ClassDB::bind_method(D_METHOD("get_spring_bone_lod_distances"), &VRMTopLevel::get_spring_bone_lod_distances);
+	ClassDB::bind_method(D_METHOD("set_spring_bone_lod_distances", "distances"), &VRMTopLevel::set_spring_bone_lod_distances);
+	ClassDB::bind_method(D_METHOD("get_spring_bone_lod_hysteresis"), &VRMTopLevel::get_spring_bone_lod_hysteresis);
+	ClassDB::bind_method(D_METHOD("set_spring_bone_lod_hysteresis", "hysteresis"), &VRMTopLevel::set_spring_bone_lod_hysteresis);
+	ClassDB::bind_method(D_METHOD("get_spring_bone_lod_blend_time"), &VRMTopLevel::get_spring_bone_lod_blend_time);
+	ClassDB::bind_method(D_METHOD("set_spring_bone_lod_blend_time", "blend_time"), &VRMTopLevel::set_spring_bone_lod_blend_time);
+	ClassDB::bind_method(D_METHOD("get_spring_bone_lod_visibility_notifier"), &VRMTopLevel::get_spring_bone_lod_visibility_notifier);
+	ClassDB::bind_method(D_METHOD("set_spring_bone_lod_visibility_notifier", "path"), &VRMTopLevel::set_spring_bone_lod_visibility_notifier);
+	ClassDB::bind_method(D_METHOD("get_spring_bone_sleep_frames"), &VRMTopLevel::get_spring_bone_sleep_frames);
+	ClassDB::bind_method(D_METHOD("set_spring_bone_sleep_frames", "frames"), &VRMTopLevel::set_spring_bone_sleep_frames);
+	ClassDB::bind_method(D_METHOD("get_spring_bone_sleep_threshold"), &VRMTopLevel::get_spring_bone_sleep_threshold);
+	ClassDB::bind_method(D_METHOD("set_spring_bone_sleep_threshold", "threshold"), &VRMTopLevel::set_spring_bone_sleep_threshold);
+	ClassDB::bind_method(D_METHOD("get_spring_bone_interaction_enabled"), &VRMTopLevel::get_spring_bone_interaction_enabled);
+	ClassDB::bind_method(D_METHOD("set_spring_bone_interaction_enabled", "enabled"), &VRMTopLevel::set_spring_bone_interaction_enabled);
+
+	ADD_PROPERTY(PropertyInfo(Variant::NODE_PATH, "vrm_skeleton"), "set_vrm_skeleton", "get_vrm_skeleton");
+	ADD_PROPERTY(PropertyInfo(Variant::NODE_PATH, "vrm_animplayer"), "set_vrm_animplayer", "get_vrm_animplayer");
+	ADD_PROPERTY(PropertyInfo(Variant::NODE_PATH, "vrm_secondary"), "set_vrm_secondary", "get_vrm_secondary");
+	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "vrm_meta", PROPERTY_HINT_RESOURCE_TYPE, "VRMMeta"), "set_vrm_meta", "get_vrm_meta");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "update_secondary_fixed"), "set_update_secondary_fixed", "get_update_secondary_fixed");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "update_in_editor"), "set_update_in_editor", "get_update_in_editor");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "gizmo_spring_bone"), "set_gizmo_spring_bone", "get_gizmo_spring_bone");
+	ADD_PROPERTY(PropertyInfo(Variant::COLOR, "gizmo_spring_bone_color"), "set_gizmo_spring_bone_color", "get_gizmo_spring_bone_color");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "gizmo_spring_bone_selected_only"), "set_gizmo_spring_bone_selected_only", "get_gizmo_spring_bone_selected_only");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "gizmo_spring_bone_redraw_rate", PROPERTY_HINT_RANGE, "0,120,1,or_greater,suffix:Hz"), "set_gizmo_spring_bone_redraw_rate", "get_gizmo_spring_bone_redraw_rate");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "gizmo_spring_bone_redraw_threshold", PROPERTY_HINT_RANGE, "0,0.1,0.001,or_greater,suffix:m"), "set_gizmo_spring_bone_redraw_threshold", "get_gizmo_spring_bone_redraw_threshold");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "spring_bone_update_mode", PROPERTY_HINT_ENUM, "Serial,Parallel,Async"), "set_spring_bone_update_mode", "get_spring_bone_update_mode");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "spring_bone_parallel_min_joints", PROPERTY_HINT_RANGE, "0,4096,1,or_greater"), "set_spring_bone_parallel_min_joints", "get_spring_bone_parallel_min_joints");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "spring_bone_fixed_step_rate", PROPERTY_HINT_RANGE, "0,240,1,suffix:Hz"), "set_spring_bone_fixed_step_rate", "get_spring_bone_fixed_step_rate");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "spring_bone_max_substeps", PROPERTY_HINT_RANGE, "1,16,1"), "set_spring_bone_max_substeps", "get_spring_bone_max_substeps");
+	ADD_GROUP("Spring Bone LOD", "spring_bone_lod_");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "spring_bone_lod_enabled"), "set_spring_bone_lod_enabled", "get_spring_bone_lod_enabled");
+	ADD_PROPERTY(PropertyInfo(Variant::VECTOR4, "spring_bone_lod_distances", PROPERTY_HINT_NONE, "suffix:m"), "set_spring_bone_lod_distances", "get_spring_bone_lod_distances");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "spring_bone_lod_hysteresis", PROPERTY_HINT_RANGE, "0,10,0.01,or_greater,suffix:m"), "set_spring_bone_lod_hysteresis", "get_spring_bone_lod_hysteresis");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "spring_bone_lod_blend_time", PROPERTY_HINT_RANGE, "0,2,0.01,or_greater,suffix:s"), "set_spring_bone_lod_blend_time", "get_spring_bone_lod_blend_time");
+	ADD_PROPERTY(PropertyInfo(Variant::NODE_PATH, "spring_bone_lod_visibility_notifier", PROPERTY_HINT_NODE_PATH_VALID_TYPES, "VisibleOnScreenNotifier3D"), "set_spring_bone_lod_visibility_notifier", "get_spring_bone_lod_visibility_notifier");
+	ADD_GROUP("Spring Bone Sleep", "spring_bone_sleep_");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "spring_bone_sleep_frames", PROPERTY_HINT_RANGE, "0,600,1,or_greater"), "set_spring_bone_sleep_frames", "get_spring_bone_sleep_frames");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "spring_bone_sleep_threshold", PROPERTY_HINT_RANGE, "0,0.01,0.0001,or_greater,suffix:m"), "set_spring_bone_sleep_threshold", "get_spring_bone_sleep_threshold");
+	ADD_GROUP("Spring Bone Interaction", "spring_bone_interaction_");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "spring_bone_interaction_enabled"), "set_spring_bone_interaction_enabled", "get_spring_bone_interaction_enabled");
+
+	BIND_ENUM_CONSTANT(SPRING_BONE_UPDATE_SERIAL);
+	BIND_ENUM_CONSTANT(SPRING_BONE_UPDATE_PARALLEL);
+	BIND_ENUM_CONSTANT(SPRING_BONE_UPDATE_ASYNC);
+
+	BIND_ENUM_CONSTANT(SPRING_BONE_LOD_FULL);
+	BIND_ENUM_CONSTANT(SPRING_BONE_LOD_HALF_RATE);
+	BIND_ENUM_CONSTANT(SPRING_BONE_LOD_QUARTER_RATE);
+	BIND_ENUM_CONSTANT(SPRING_BONE_LOD_ROOT_ONLY);
+	BIND_ENUM_CONSTANT(SPRING_BONE_LOD_FROZEN);
+}
+
+void VRMTopLevel::set_gizmo_spring_bone_color(Color p_color) {
+	gizmo_spring_bone_color = p_color;
+}
+
+Quaternion VRMTopLevel::from_to_rotation(Vector3 from, Vector3 to) {
+	Vector3 axis = from.cross(to);
+	if (Math::is_equal_approx(axis.x, real_t(0.0)) && Math::is_equal_approx(axis.y, real_t(0.0)) && Math::is_equal_approx(axis.z, real_t(0.0))) {
+		return Quaternion();
+	}
+	real_t angle = from.angle_to(to);
+	if (Math::is_equal_approx(angle, real_t(0.0))) {
+		angle = 0.0;
+	}
+	return Quaternion(axis.normalized(), angle);
+}
+
+void VRMPackedVector3s::clear() {
+	x.clear();
+	y.clear();
+	z.clear();
+}
+void VRMPackedVector3s::resize(uint32_t p_size) {
+	x.resize(p_size);
+	y.resize(p_size);
+	z.resize(p_size);
+}
+void VRMPackedVector3s::push_back(const Vector3 &p_value) {
+	x.push_back(p_value.x);
+	y.push_back(p_value.y);
+	z.push_back(p_value.z);
+}
+void VRMColliderTable::clear() {
+	local_positions.clear();
+	local_tails.clear();
+	radii.clear();
+	shapes.clear();
+	positions.clear();
+	tails.clear();
+	groups.clear();
+	external_begin = 0;
+}
+void VRMColliderTable::add_collider(Shape p_shape, const Vector3 &p_position, const Vector3 &p_tail, real_t p_radius) {
+	local_positions.push_back(p_position);
+	local_tails.push_back(p_tail);
+	radii.push_back(p_radius);
+	shapes.push_back(p_shape);
+	positions.push_back(p_position);
+	tails.push_back(p_tail);
+}
+void VRMColliderTable::clear_external() {
+	local_positions.resize(external_begin);
+	local_tails.resize(external_begin);
+	radii.resize(external_begin);
+	shapes.resize(external_begin);
+	positions.resize(external_begin);
+	tails.resize(external_begin);
+}
+bool VRMColliderTable::shape_can_reach(Shape p_shape, const Vector3 &p_position, const Vector3 &p_tail, real_t p_collider_radius, const Vector3 &p_center, real_t p_radius) {
+	switch (p_shape) {
+		case SHAPE_SPHERE: {
+			const real_t reach = p_radius + p_collider_radius;
+			return p_center.distance_squared_to(p_position) <= reach * reach;
+		}
+		case SHAPE_CAPSULE: {
+			const Vector3 segment = p_tail - p_position;
+			Vector3 closest = p_position;
+			if (segment.length_squared() > 0) {
+				closest += segment * CLAMP((p_center - p_position).dot(segment) / segment.length_squared(), real_t(0.0), real_t(1.0));
+			}
+			const real_t reach = p_radius + p_collider_radius;
+			return p_center.distance_squared_to(closest) <= reach * reach;
+		}
+		case SHAPE_PLANE: {
+			return (p_center - p_position).dot(p_tail) <= p_radius;
+		}
+	}
+	return true;
+}
+
+// Inputs of the batched verlet integration and collision kernel. Joint
+// indices index every joint array; all positions are in world space. Only
+// the colliders listed in collider_indices are tested.
+struct VRMSpringBoneKernelArgs {
+	const VRMPackedVector3s *current_tail = nullptr;
+	const VRMPackedVector3s *prev_tail = nullptr;
+	const VRMPackedVector3s *origin = nullptr;
+	const VRMPackedVector3s *axis = nullptr;
+	const real_t *length = nullptr;
+	const real_t *radius = nullptr;
+	VRMPackedVector3s *next_tail = nullptr;
+	const VRMPackedVector3s *collider_positions = nullptr;
+	const real_t *collider_radii = nullptr;
+	const VRMPackedVector3s *collider_tails = nullptr;
+	const uint8_t *collider_shapes = nullptr;
+	const uint32_t *collider_indices = nullptr;
+	uint32_t collider_count = 0;
+	real_t drag = 0;
+	real_t stiffness = 0;
+	Vector3 external;
+};
+
+static _FORCE_INLINE_ void _integrate_joint(const VRMSpringBoneKernelArgs &p_args, uint32_t p_joint) {
+	const Vector3 current_tail = p_args.current_tail->get(p_joint);
+	const Vector3 prev_tail = p_args.prev_tail->get(p_joint);
+	const Vector3 origin = p_args.origin->get(p_joint);
+	const real_t length = p_args.length[p_joint];
+	const real_t radius = p_args.radius[p_joint];
+
+	// Integration of velocity verlet
+	Vector3 next_tail = current_tail + (current_tail - prev_tail) * (1.0 - p_args.drag) + p_args.axis->get(p_joint) * p_args.stiffness + p_args.external;
+
+	// Limiting bone length
+	next_tail = origin + (next_tail - origin).normalized() * length;
+
+	// Collision movement
+	for (uint32_t index_i = 0; index_i < p_args.collider_count; index_i++) {
+		const uint32_t collider_i = p_args.collider_indices[index_i];
+		Vector3 collider_position = p_args.collider_positions->get(collider_i);
+		if (p_args.collider_shapes[collider_i] == VRMColliderTable::SHAPE_PLANE) {
+			const Vector3 normal = p_args.collider_tails->get(collider_i);
+			const real_t distance = (next_tail - collider_position).dot(normal) - radius;
+			if (distance < 0) {
+				// Hit, move out along the normal
+				next_tail = origin + (next_tail - normal * distance - origin).normalized() * length;
+			}
+			continue;
+		}
+		if (p_args.collider_shapes[collider_i] == VRMColliderTable::SHAPE_CAPSULE) {
+			// Collide with the closest point on the capsule segment.
+			const Vector3 segment = p_args.collider_tails->get(collider_i) - collider_position;
+			const real_t segment_length_squared = segment.length_squared();
+			if (segment_length_squared > 0) {
+				collider_position += segment * CLAMP((next_tail - collider_position).dot(segment) / segment_length_squared, real_t(0.0), real_t(1.0));
+			}
+		}
+		real_t r = radius + p_args.collider_radii[collider_i];
+		Vector3 diff = next_tail - collider_position;
+		if (diff.length_squared() <= r * r) {
+			// Hit, move to orientation of normal
+			Vector3 pos_from_collider = collider_position + diff.normalized() * r;
+			// Limiting bone length
+			next_tail = origin + (pos_from_collider - origin).normalized() * length;
+		}
+	}
+	p_args.next_tail->set(p_joint, next_tail);
+}
+
+#if defined(VRM_SPRING_BONE_SIMD_SSE2) || defined(VRM_SPRING_BONE_SIMD_NEON)
+#if defined(VRM_SPRING_BONE_SIMD_SSE2)
+typedef __m128 vrm_float4;
+static _FORCE_INLINE_ vrm_float4 vrm_load4(const float *p_src) { return _mm_loadu_ps(p_src); }
+static _FORCE_INLINE_ void vrm_store4(float *p_dst, vrm_float4 p_value) { _mm_storeu_ps(p_dst, p_value); }
+static _FORCE_INLINE_ vrm_float4 vrm_set4(float p_value) { return _mm_set1_ps(p_value); }
+static _FORCE_INLINE_ vrm_float4 vrm_add4(vrm_float4 p_a, vrm_float4 p_b) { return _mm_add_ps(p_a, p_b); }
+static _FORCE_INLINE_ vrm_float4 vrm_sub4(vrm_float4 p_a, vrm_float4 p_b) { return _mm_sub_ps(p_a, p_b); }
+static _FORCE_INLINE_ vrm_float4 vrm_mul4(vrm_float4 p_a, vrm_float4 p_b) { return _mm_mul_ps(p_a, p_b); }
+static _FORCE_INLINE_ vrm_float4 vrm_div4(vrm_float4 p_a, vrm_float4 p_b) { return _mm_div_ps(p_a, p_b); }
+static _FORCE_INLINE_ vrm_float4 vrm_min4(vrm_float4 p_a, vrm_float4 p_b) { return _mm_min_ps(p_a, p_b); }
+static _FORCE_INLINE_ vrm_float4 vrm_max4(vrm_float4 p_a, vrm_float4 p_b) { return _mm_max_ps(p_a, p_b); }
+static _FORCE_INLINE_ vrm_float4 vrm_sqrt4(vrm_float4 p_a) { return _mm_sqrt_ps(p_a); }
+static _FORCE_INLINE_ vrm_float4 vrm_greater4(vrm_float4 p_a, vrm_float4 p_b) { return _mm_cmpgt_ps(p_a, p_b); }
+static _FORCE_INLINE_ vrm_float4 vrm_less_equal4(vrm_float4 p_a, vrm_float4 p_b) { return _mm_cmple_ps(p_a, p_b); }
+static _FORCE_INLINE_ vrm_float4 vrm_and4(vrm_float4 p_mask, vrm_float4 p_a) { return _mm_and_ps(p_mask, p_a); }
+static _FORCE_INLINE_ vrm_float4 vrm_select4(vrm_float4 p_mask, vrm_float4 p_a, vrm_float4 p_b) { return _mm_or_ps(_mm_and_ps(p_mask, p_a), _mm_andnot_ps(p_mask, p_b)); }
+static _FORCE_INLINE_ bool vrm_any4(vrm_float4 p_mask) { return _mm_movemask_ps(p_mask) != 0; }
+#else
+typedef float32x4_t vrm_float4;
+static _FORCE_INLINE_ vrm_float4 vrm_load4(const float *p_src) { return vld1q_f32(p_src); }
+static _FORCE_INLINE_ void vrm_store4(float *p_dst, vrm_float4 p_value) { vst1q_f32(p_dst, p_value); }
+static _FORCE_INLINE_ vrm_float4 vrm_set4(float p_value) { return vdupq_n_f32(p_value); }
+static _FORCE_INLINE_ vrm_float4 vrm_add4(vrm_float4 p_a, vrm_float4 p_b) { return vaddq_f32(p_a, p_b); }
+static _FORCE_INLINE_ vrm_float4 vrm_sub4(vrm_float4 p_a, vrm_float4 p_b) { return vsubq_f32(p_a, p_b); }
+static _FORCE_INLINE_ vrm_float4 vrm_mul4(vrm_float4 p_a, vrm_float4 p_b) { return vmulq_f32(p_a, p_b); }
+static _FORCE_INLINE_ vrm_float4 vrm_div4(vrm_float4 p_a, vrm_float4 p_b) { return vdivq_f32(p_a, p_b); }
+static _FORCE_INLINE_ vrm_float4 vrm_min4(vrm_float4 p_a, vrm_float4 p_b) { return vminq_f32(p_a, p_b); }
+static _FORCE_INLINE_ vrm_float4 vrm_max4(vrm_float4 p_a, vrm_float4 p_b) { return vmaxq_f32(p_a, p_b); }
+static _FORCE_INLINE_ vrm_float4 vrm_sqrt4(vrm_float4 p_a) { return vsqrtq_f32(p_a); }
+static _FORCE_INLINE_ vrm_float4 vrm_greater4(vrm_float4 p_a, vrm_float4 p_b) { return vreinterpretq_f32_u32(vcgtq_f32(p_a, p_b)); }
+static _FORCE_INLINE_ vrm_float4 vrm_less_equal4(vrm_float4 p_a, vrm_float4 p_b) { return vreinterpretq_f32_u32(vcleq_f32(p_a, p_b)); }
+static _FORCE_INLINE_ vrm_float4 vrm_and4(vrm_float4 p_mask, vrm_float4 p_a) { return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(p_mask), vreinterpretq_u32_f32(p_a))); }
+static _FORCE_INLINE_ vrm_float4 vrm_select4(vrm_float4 p_mask, vrm_float4 p_a, vrm_float4 p_b) { return vbslq_f32(vreinterpretq_u32_f32(p_mask), p_a, p_b); }
+static _FORCE_INLINE_ bool vrm_any4(vrm_float4 p_mask) { return vmaxvq_u32(vreinterpretq_u32_f32(p_mask)) != 0; }
+#endif
+
+// Returns p_length / |v|, or zero for a zero vector like Vector3::normalized().
+static _FORCE_INLINE_ vrm_float4 vrm_length_scale4(vrm_float4 p_x, vrm_float4 p_y, vrm_float4 p_z, vrm_float4 p_length) {
+	vrm_float4 length_squared = vrm_add4(vrm_add4(vrm_mul4(p_x, p_x), vrm_mul4(p_y, p_y)), vrm_mul4(p_z, p_z));
+	vrm_float4 valid = vrm_greater4(length_squared, vrm_set4(0.0f));
+	return vrm_and4(valid, vrm_div4(p_length, vrm_sqrt4(length_squared)));
+}
+
+// Same math as _integrate_joint, four joints per iteration.
+static uint32_t _integrate_joints_simd(const VRMSpringBoneKernelArgs &p_args, uint32_t p_begin, uint32_t p_end) {
+	const vrm_float4 inertia = vrm_set4(1.0f - p_args.drag);
+	const vrm_float4 stiffness = vrm_set4(p_args.stiffness);
+	const vrm_float4 external_x = vrm_set4(p_args.external.x);
+	const vrm_float4 external_y = vrm_set4(p_args.external.y);
+	const vrm_float4 external_z = vrm_set4(p_args.external.z);
+	uint32_t joint_i = p_begin;
+	for (; joint_i + 4 <= p_end; joint_i += 4) {
+		const vrm_float4 current_x = vrm_load4(p_args.current_tail->x.ptr() + joint_i);
+		const vrm_float4 current_y = vrm_load4(p_args.current_tail->y.ptr() + joint_i);
+		const vrm_float4 current_z = vrm_load4(p_args.current_tail->z.ptr() + joint_i);
+		const vrm_float4 origin_x = vrm_load4(p_args.origin->x.ptr() + joint_i);
+		const vrm_float4 origin_y = vrm_load4(p_args.origin->y.ptr() + joint_i);
+		const vrm_float4 origin_z = vrm_load4(p_args.origin->z.ptr() + joint_i);
+		const vrm_float4 length = vrm_load4(p_args.length + joint_i);
+		const vrm_float4 radius = vrm_load4(p_args.radius + joint_i);
+
+		// Integration of velocity verlet
+		vrm_float4 next_x = vrm_add4(current_x, vrm_mul4(vrm_sub4(current_x, vrm_load4(p_args.prev_tail->x.ptr() + joint_i)), inertia));
+		vrm_float4 next_y = vrm_add4(current_y, vrm_mul4(vrm_sub4(current_y, vrm_load4(p_args.prev_tail->y.ptr() + joint_i)), inertia));
+		vrm_float4 next_z = vrm_add4(current_z, vrm_mul4(vrm_sub4(current_z, vrm_load4(p_args.prev_tail->z.ptr() + joint_i)), inertia));
+		next_x = vrm_add4(vrm_add4(next_x, vrm_mul4(vrm_load4(p_args.axis->x.ptr() + joint_i), stiffness)), external_x);
+		next_y = vrm_add4(vrm_add4(next_y, vrm_mul4(vrm_load4(p_args.axis->y.ptr() + joint_i), stiffness)), external_y);
+		next_z = vrm_add4(vrm_add4(next_z, vrm_mul4(vrm_load4(p_args.axis->z.ptr() + joint_i), stiffness)), external_z);
+
+		// Limiting bone length
+		vrm_float4 dir_x = vrm_sub4(next_x, origin_x);
+		vrm_float4 dir_y = vrm_sub4(next_y, origin_y);
+		vrm_float4 dir_z = vrm_sub4(next_z, origin_z);
+		vrm_float4 scale = vrm_length_scale4(dir_x, dir_y, dir_z, length);
+		next_x = vrm_add4(origin_x, vrm_mul4(dir_x, scale));
+		next_y = vrm_add4(origin_y, vrm_mul4(dir_y, scale));
+		next_z = vrm_add4(origin_z, vrm_mul4(dir_z, scale));
+
+		// Collision movement
+		for (uint32_t index_i = 0; index_i < p_args.collider_count; index_i++) {
+			const uint32_t collider_i = p_args.collider_indices[index_i];
+			vrm_float4 collider_x = vrm_set4(p_args.collider_positions->x[collider_i]);
+			vrm_float4 collider_y = vrm_set4(p_args.collider_positions->y[collider_i]);
+			vrm_float4 collider_z = vrm_set4(p_args.collider_positions->z[collider_i]);
+			const uint8_t shape = p_args.collider_shapes[collider_i];
+			if (shape == VRMColliderTable::SHAPE_PLANE) {
+				const vrm_float4 normal_x = vrm_set4(p_args.collider_tails->x[collider_i]);
+				const vrm_float4 normal_y = vrm_set4(p_args.collider_tails->y[collider_i]);
+				const vrm_float4 normal_z = vrm_set4(p_args.collider_tails->z[collider_i]);
+				const vrm_float4 distance = vrm_sub4(vrm_add4(vrm_add4(vrm_mul4(vrm_sub4(next_x, collider_x), normal_x), vrm_mul4(vrm_sub4(next_y, collider_y), normal_y)), vrm_mul4(vrm_sub4(next_z, collider_z), normal_z)), radius);
+				const vrm_float4 hit = vrm_greater4(vrm_set4(0.0f), distance);
+				if (!vrm_any4(hit)) {
+					continue;
+				}
+				// Hit, move out along the normal
+				dir_x = vrm_sub4(vrm_sub4(next_x, vrm_mul4(normal_x, distance)), origin_x);
+				dir_y = vrm_sub4(vrm_sub4(next_y, vrm_mul4(normal_y, distance)), origin_y);
+				dir_z = vrm_sub4(vrm_sub4(next_z, vrm_mul4(normal_z, distance)), origin_z);
+				scale = vrm_length_scale4(dir_x, dir_y, dir_z, length);
+				next_x = vrm_select4(hit, vrm_add4(origin_x, vrm_mul4(dir_x, scale)), next_x);
+				next_y = vrm_select4(hit, vrm_add4(origin_y, vrm_mul4(dir_y, scale)), next_y);
+				next_z = vrm_select4(hit, vrm_add4(origin_z, vrm_mul4(dir_z, scale)), next_z);
+				continue;
+			}
+			if (shape == VRMColliderTable::SHAPE_CAPSULE) {
+				// Collide with the closest point on the capsule segment.
+				const real_t segment_x = p_args.collider_tails->x[collider_i] - p_args.collider_positions->x[collider_i];
+				const real_t segment_y = p_args.collider_tails->y[collider_i] - p_args.collider_positions->y[collider_i];
+				const real_t segment_z = p_args.collider_tails->z[collider_i] - p_args.collider_positions->z[collider_i];
+				const real_t segment_length_squared = segment_x * segment_x + segment_y * segment_y + segment_z * segment_z;
+				if (segment_length_squared > 0) {
+					const vrm_float4 project = vrm_add4(vrm_add4(vrm_mul4(vrm_sub4(next_x, collider_x), vrm_set4(segment_x)), vrm_mul4(vrm_sub4(next_y, collider_y), vrm_set4(segment_y))), vrm_mul4(vrm_sub4(next_z, collider_z), vrm_set4(segment_z)));
+					const vrm_float4 t = vrm_min4(vrm_max4(vrm_div4(project, vrm_set4(segment_length_squared)), vrm_set4(0.0f)), vrm_set4(1.0f));
+					collider_x = vrm_add4(collider_x, vrm_mul4(vrm_set4(segment_x), t));
+					collider_y = vrm_add4(collider_y, vrm_mul4(vrm_set4(segment_y), t));
+					collider_z = vrm_add4(collider_z, vrm_mul4(vrm_set4(segment_z), t));
+				}
+			}
+			const vrm_float4 r = vrm_add4(radius, vrm_set4(p_args.collider_radii[collider_i]));
+			const vrm_float4 diff_x = vrm_sub4(next_x, collider_x);
+			const vrm_float4 diff_y = vrm_sub4(next_y, collider_y);
+			const vrm_float4 diff_z = vrm_sub4(next_z, collider_z);
+			const vrm_float4 distance_squared = vrm_add4(vrm_add4(vrm_mul4(diff_x, diff_x), vrm_mul4(diff_y, diff_y)), vrm_mul4(diff_z, diff_z));
+			const vrm_float4 hit = vrm_less_equal4(distance_squared, vrm_mul4(r, r));
+			if (!vrm_any4(hit)) {
+				continue;
+			}
+			// Hit, move to orientation of normal
+			vrm_float4 push = vrm_length_scale4(diff_x, diff_y, diff_z, r);
+			dir_x = vrm_sub4(vrm_add4(collider_x, vrm_mul4(diff_x, push)), origin_x);
+			dir_y = vrm_sub4(vrm_add4(collider_y, vrm_mul4(diff_y, push)), origin_y);
+			dir_z = vrm_sub4(vrm_add4(collider_z, vrm_mul4(diff_z, push)), origin_z);
+			// Limiting bone length
+			scale = vrm_length_scale4(dir_x, dir_y, dir_z, length);
+			next_x = vrm_select4(hit, vrm_add4(origin_x, vrm_mul4(dir_x, scale)), next_x);
+			next_y = vrm_select4(hit, vrm_add4(origin_y, vrm_mul4(dir_y, scale)), next_y);
+			next_z = vrm_select4(hit, vrm_add4(origin_z, vrm_mul4(dir_z, scale)), next_z);
+		}
+		vrm_store4(p_args.next_tail->x.ptr() + joint_i, next_x);
+		vrm_store4(p_args.next_tail->y.ptr() + joint_i, next_y);
+		vrm_store4(p_args.next_tail->z.ptr() + joint_i, next_z);
+	}
+	return joint_i;
+}
+#endif
+
+// Runs the kernel over the joints [p_begin, p_end), four at a time where the
+// target supports SSE2 or NEON. Leftover joints use the scalar path.
+static void _integrate_joints(const VRMSpringBoneKernelArgs &p_args, uint32_t p_begin, uint32_t p_end) {
+	uint32_t joint_i = p_begin;
+#if defined(VRM_SPRING_BONE_SIMD_SSE2) || defined(VRM_SPRING_BONE_SIMD_NEON)
+	joint_i = _integrate_joints_simd(p_args, p_begin, p_end);
+#endif
+	for (; joint_i < p_end; joint_i++) {
+		_integrate_joint(p_args, joint_i);
+	}
+}
+
+void VRMPackedVector3s::set_xformed(const VRMPackedVector3s &p_from, const Transform3D &p_transform, uint32_t p_begin, uint32_t p_end) {
+	uint32_t index_i = p_begin;
+#if defined(VRM_SPRING_BONE_SIMD_SSE2) || defined(VRM_SPRING_BONE_SIMD_NEON)
+	const Basis &basis = p_transform.basis;
+	const vrm_float4 xx = vrm_set4(basis.rows[0].x);
+	const vrm_float4 xy = vrm_set4(basis.rows[0].y);
+	const vrm_float4 xz = vrm_set4(basis.rows[0].z);
+	const vrm_float4 yx = vrm_set4(basis.rows[1].x);
+	const vrm_float4 yy = vrm_set4(basis.rows[1].y);
+	const vrm_float4 yz = vrm_set4(basis.rows[1].z);
+	const vrm_float4 zx = vrm_set4(basis.rows[2].x);
+	const vrm_float4 zy = vrm_set4(basis.rows[2].y);
+	const vrm_float4 zz = vrm_set4(basis.rows[2].z);
+	const vrm_float4 origin_x = vrm_set4(p_transform.origin.x);
+	const vrm_float4 origin_y = vrm_set4(p_transform.origin.y);
+	const vrm_float4 origin_z = vrm_set4(p_transform.origin.z);
+	for (; index_i + 4 <= p_end; index_i += 4) {
+		const vrm_float4 from_x = vrm_load4(p_from.x.ptr() + index_i);
+		const vrm_float4 from_y = vrm_load4(p_from.y.ptr() + index_i);
+		const vrm_float4 from_z = vrm_load4(p_from.z.ptr() + index_i);
+		vrm_store4(x.ptr() + index_i, vrm_add4(origin_x, vrm_add4(vrm_add4(vrm_mul4(xx, from_x), vrm_mul4(xy, from_y)), vrm_mul4(xz, from_z))));
+		vrm_store4(y.ptr() + index_i, vrm_add4(origin_y, vrm_add4(vrm_add4(vrm_mul4(yx, from_x), vrm_mul4(yy, from_y)), vrm_mul4(yz, from_z))));
+		vrm_store4(z.ptr() + index_i, vrm_add4(origin_z, vrm_add4(vrm_add4(vrm_mul4(zx, from_x), vrm_mul4(zy, from_y)), vrm_mul4(zz, from_z))));
+	}
+#endif
+	for (; index_i < p_end; index_i++) {
+		set(index_i, p_transform.xform(p_from.get(index_i)));
+	}
+}
+
+void VRMSpringBoneJoints::clear() {
+	bone_idx.clear();
+	parent.clear();
+	bone_axis.clear();
+	length.clear();
+	radius.clear();
+	current_tail.clear();
+	prev_tail.clear();
+	level_offsets.clear();
+	sleep_origin.clear();
+	animated_pose.clear();
+	reach.clear();
+	origin.clear();
+	axis.clear();
+	rotation.clear();
+	world_current_tail.clear();
+	world_prev_tail.clear();
+	next_tail.clear();
+	solved_pose.clear();
+	chains.clear();
+}
+uint32_t VRMSpringBoneJoints::add_joint(int32_t p_bone_idx, int32_t p_parent) {
+	uint32_t joint = size();
+	bone_idx.push_back(p_bone_idx);
+	parent.push_back(p_parent);
+	bone_axis.push_back(Vector3());
+	length.push_back(0);
+	radius.push_back(0);
+	current_tail.push_back(Vector3());
+	prev_tail.push_back(Vector3());
+	sleep_origin.push_back(Vector3());
+	animated_pose.push_back(Transform3D());
+	reach.push_back(0);
+	origin.push_back(Vector3());
+	axis.push_back(Vector3());
+	rotation.push_back(Quaternion());
+	world_current_tail.push_back(Vector3());
+	world_prev_tail.push_back(Vector3());
+	next_tail.push_back(Vector3());
+	solved_pose.push_back(Transform3D());
+	return joint;
+}
+void VRMSecondary::_notification(int p_what) {
+	switch (p_what) {
+		case NOTIFICATION_READY: {
+			bool gizmo_spring_bone = false;
+			VRMTopLevel::SpringBoneUpdateMode spring_bone_update_mode = VRMTopLevel::SPRING_BONE_UPDATE_SERIAL;
+			int spring_bone_parallel_min_joints = 128;
+			int spring_bone_fixed_step_rate = 0;
+			int spring_bone_max_substeps = 4;
+			real_t spring_bone_lod_blend_time = 0.25;
+			int spring_bone_sleep_frames = 0;
+			real_t spring_bone_sleep_threshold = 0.0005;
+			bool spring_bone_interaction_enabled = false;
+			spring_bone_lod_enabled = false;
+			spring_bone_lod_visibility_notifier = ObjectID();
+			VRMTopLevel *vrm_top_level = cast_to<VRMTopLevel>(get_parent());
+			if (vrm_top_level) {
+				update_secondary_fixed = vrm_top_level->get_update_secondary_fixed();
+				gizmo_spring_bone = vrm_top_level->get_gizmo_spring_bone();
+				spring_bone_update_mode = vrm_top_level->get_spring_bone_update_mode();
+				spring_bone_parallel_min_joints = vrm_top_level->get_spring_bone_parallel_min_joints();
+				spring_bone_fixed_step_rate = vrm_top_level->get_spring_bone_fixed_step_rate();
+				spring_bone_max_substeps = vrm_top_level->get_spring_bone_max_substeps();
+				spring_bone_lod_enabled = vrm_top_level->get_spring_bone_lod_enabled();
+				spring_bone_lod_distances = vrm_top_level->get_spring_bone_lod_distances();
+				spring_bone_lod_hysteresis = vrm_top_level->get_spring_bone_lod_hysteresis();
+				spring_bone_lod_blend_time = vrm_top_level->get_spring_bone_lod_blend_time();
+				spring_bone_sleep_frames = vrm_top_level->get_spring_bone_sleep_frames();
+				spring_bone_sleep_threshold = vrm_top_level->get_spring_bone_sleep_threshold();
+				spring_bone_interaction_enabled = vrm_top_level->get_spring_bone_interaction_enabled();
+				Node *notifier = vrm_top_level->get_node_or_null(vrm_top_level->get_spring_bone_lod_visibility_notifier());
+				if (cast_to<VisibleOnScreenNotifier3D>(notifier)) {
+					spring_bone_lod_visibility_notifier = notifier->get_instance_id();
+				}
+			}
+			if (secondary_gizmo == nullptr && (Engine::get_singleton()->is_editor_hint() || gizmo_spring_bone)) {
+				secondary_gizmo = memnew(SecondaryGizmo(this));
+				add_child(secondary_gizmo, true);
+			}
+			VRMSpringBoneServer *server = VRMSpringBoneServer::get_singleton();
+			if (!avatar.is_valid()) {
+				avatar = server->avatar_create();
+			}
+			server->avatar_setup(avatar, this, spring_bones, collider_groups);
+			server->avatar_set_physics_process(avatar, update_secondary_fixed);
+			server->avatar_set_update_mode(avatar, spring_bone_update_mode, spring_bone_parallel_min_joints);
+			server->avatar_set_fixed_step(avatar, spring_bone_fixed_step_rate, spring_bone_max_substeps);
+			server->avatar_set_lod_blend_time(avatar, spring_bone_lod_blend_time);
+			server->avatar_set_sleep(avatar, spring_bone_sleep_frames, spring_bone_sleep_threshold);
+			server->avatar_set_interaction(avatar, spring_bone_interaction_enabled);
+			spring_bone_lod = VRMTopLevel::SPRING_BONE_LOD_FULL;
+			server->avatar_set_lod(avatar, spring_bone_lod);
+			set_process(!update_secondary_fixed);
+			set_physics_process(update_secondary_fixed);
+		} break;
+		case NOTIFICATION_PREDELETE: {
+			if (avatar.is_valid()) {
+				VRMSpringBoneServer::get_singleton()->avatar_free(avatar);
+				avatar = RID();
+			}
+		} break;
+		case NOTIFICATION_PROCESS: {
+			_update_spring_bones(get_process_delta_time(), false);
+		} break;
+		case NOTIFICATION_PHYSICS_PROCESS: {
+			_update_spring_bones(get_physics_process_delta_time(), true);
+		} break;
+	}
+}
+void VRMSecondary::_update_spring_bones(double p_delta, bool p_physics_process) {
+	VRMSpringBoneServer *server = VRMSpringBoneServer::get_singleton();
+	bool do_update = !Engine::get_singleton()->is_editor_hint() || check_for_editor_update();
+	server->avatar_set_active(avatar, do_update);
+	if (spring_bone_lod_enabled && !Engine::get_singleton()->is_editor_hint()) {
+		_update_spring_bone_lod();
+	}
+	// The first avatar to process in a frame steps all of them; animation has
+	// been applied by then since it runs in the internal process.
+	server->step(p_delta, p_physics_process);
+	if (!secondary_gizmo) {
+		return;
+	}
+	const uint64_t begin_usec = OS::get_singleton()->get_ticks_usec();
+	if (do_update) {
+		if (Engine::get_singleton()->is_editor_hint()) {
+			secondary_gizmo->draw_in_editor(true);
+		} else {
+			secondary_gizmo->draw_in_game();
+		}
+	} else if (Engine::get_singleton()->is_editor_hint()) {
+		secondary_gizmo->draw_in_editor();
+	}
+	server->add_gizmo_draw_time(OS::get_singleton()->get_ticks_usec() - begin_usec);
+}
+void VRMSecondary::_update_spring_bone_lod() {
+	int lod = spring_bone_lod;
+	VisibleOnScreenNotifier3D *notifier = Object::cast_to<VisibleOnScreenNotifier3D>(ObjectDB::get_instance(spring_bone_lod_visibility_notifier));
+	Camera3D *camera = get_viewport() ? get_viewport()->get_camera_3d() : nullptr;
+	if (notifier && !notifier->is_on_screen()) {
+		lod = VRMTopLevel::SPRING_BONE_LOD_FROZEN;
+	} else if (camera) {
+		// Only move past a tier boundary once the distance clears it by the
+		// hysteresis margin, so avatars near a boundary do not flicker.
+		const real_t distance = camera->get_global_position().distance_to(get_global_position());
+		const real_t boundaries[4] = { spring_bone_lod_distances.x, spring_bone_lod_distances.y, spring_bone_lod_distances.z, spring_bone_lod_distances.w };
+		while (lod < VRMTopLevel::SPRING_BONE_LOD_FROZEN && distance > boundaries[lod] + spring_bone_lod_hysteresis) {
+			lod++;
+		}
+		while (lod > VRMTopLevel::SPRING_BONE_LOD_FULL && distance < boundaries[lod - 1] - spring_bone_lod_hysteresis) {
+			lod--;
+		}
+	}
+	if (lod != spring_bone_lod) {
+		spring_bone_lod = VRMTopLevel::SpringBoneLOD(lod);
+		VRMSpringBoneServer::get_singleton()->avatar_set_lod(avatar, spring_bone_lod);
+	}
+}
+Error VRMSecondary::start_trace_recording(const String &p_path) {
+	ERR_FAIL_COND_V_MSG(!avatar.is_valid(), ERR_UNCONFIGURED, "VRMSecondary must be ready before recording a trace.");
+	spring_bone_lod = VRMTopLevel::SPRING_BONE_LOD_FULL;
+	return VRMSpringBoneServer::get_singleton()->avatar_trace_record(avatar, p_path);
+}
+Error VRMSecondary::start_trace_replay(const String &p_path, const String &p_output_path) {
+	ERR_FAIL_COND_V_MSG(!avatar.is_valid(), ERR_UNCONFIGURED, "VRMSecondary must be ready before replaying a trace.");
+	spring_bone_lod = VRMTopLevel::SPRING_BONE_LOD_FULL;
+	return VRMSpringBoneServer::get_singleton()->avatar_trace_replay(avatar, p_path, p_output_path);
+}
+void VRMSecondary::stop_trace() {
+	if (avatar.is_valid()) {
+		VRMSpringBoneServer::get_singleton()->avatar_trace_stop(avatar);
+	}
+}
+bool VRMSecondary::is_trace_replaying() const {
+	return avatar.is_valid() && VRMSpringBoneServer::get_singleton()->avatar_get_trace_mode(avatar) == VRMSpringBoneServer::TRACE_REPLAY;
+}
+void VRMSecondary::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("start_trace_recording", "path"), &VRMSecondary::start_trace_recording);
+	ClassDB::bind_method(D_METHOD("start_trace_replay", "path", "output_path"), &VRMSecondary::start_trace_replay, DEFVAL(String()));
+	ClassDB::bind_method(D_METHOD("stop_trace"), &VRMSecondary::stop_trace);
+	ClassDB::bind_method(D_METHOD("is_trace_replaying"), &VRMSecondary::is_trace_replaying);
+}
+bool VRMSecondary::check_for_editor_update() {
+	if (!Engine::get_singleton()->is_editor_hint()) {
+		return false;
+	}
+	Node *parent = get_parent();
+	VRMTopLevel *vrm_top_level = cast_to<VRMTopLevel>(parent);
+	if (vrm_top_level) {
+		if (vrm_top_level->get_update_in_editor() && !update_in_editor) {
+			update_in_editor = true;
+			_notification(NOTIFICATION_READY);
+		}
+	}
+	if (!parent->get("update_in_editor") && update_in_editor) {
+		update_in_editor = false;
+		VRMSpringBoneServer::get_singleton()->avatar_clear_poses(avatar);
+	}
+	return update_in_editor;
+}
+Ref<Resource> VRMSpringBone::duplicate(bool p_subresources) const {
+	Ref<VRMSpringBone> spring_bone;
+	spring_bone.instantiate();
+	spring_bone->set_name(get_name());
+	spring_bone->comment = comment;
+	spring_bone->stiffness_force = stiffness_force;
+	spring_bone->gravity_power = gravity_power;
+	spring_bone->gravity_dir = gravity_dir;
+	spring_bone->drag_force = drag_force;
+	spring_bone->skeleton = skeleton;
+	spring_bone->center_bone = center_bone;
+	spring_bone->center_node = center_node;
+	spring_bone->hit_radius = hit_radius;
+	spring_bone->root_bones = root_bones;
+	spring_bone->collider_groups = collider_groups.duplicate();
+	spring_bone->baked_joint_bones = baked_joint_bones;
+	spring_bone->baked_joint_parents = baked_joint_parents;
+	spring_bone->baked_joint_depths = baked_joint_depths;
+	spring_bone->baked_joint_tails = baked_joint_tails;
+	spring_bone->baked_skeleton_hash = baked_skeleton_hash;
+	return spring_bone;
+}
+void VRMSpringBone::bake_joints(const Skeleton3D *p_skeleton, uint32_t p_skeleton_hash) {
+	ERR_FAIL_NULL(p_skeleton);
+	baked_joint_bones.clear();
+	baked_joint_parents.clear();
+	baked_joint_depths.clear();
+	baked_joint_tails.clear();
+	baked_skeleton_hash = p_skeleton_hash;
+	for (const String &root_bone : root_bones) {
+		if (root_bone.is_empty()) {
+			continue;
+		}
+		const int root_id = p_skeleton->find_bone(root_bone);
+		if (root_id == -1) {
+			continue;
+		}
+		// Breadth first, so each chain is stored level by level.
+		int32_t joint_i = baked_joint_bones.size();
+		baked_joint_bones.push_back(root_id);
+		baked_joint_parents.push_back(-1);
+		baked_joint_depths.push_back(0);
+		for (; joint_i < baked_joint_bones.size(); joint_i++) {
+			const int bone = baked_joint_bones[joint_i];
+			const Vector<int> children = p_skeleton->get_bone_children(bone);
+			Vector3 local_child_position;
+			if (children.is_empty()) {
+				local_child_position = p_skeleton->get_bone_rest(bone).origin.normalized() * 0.07;
+			} else {
+				const Transform3D child_rest = p_skeleton->get_bone_rest(children[0]);
+				local_child_position = child_rest.origin * child_rest.basis.get_scale();
+			}
+			baked_joint_tails.push_back(local_child_position);
+			for (int child : children) {
+				baked_joint_bones.push_back(child);
+				baked_joint_parents.push_back(joint_i);
+				baked_joint_depths.push_back(baked_joint_depths[joint_i] + 1);
+			}
+		}
+	}
+}
+uint32_t VRMSpringBone::skeleton_bake_hash(const Skeleton3D *p_skeleton) {
+	ERR_FAIL_NULL_V(p_skeleton, 0);
+	const int bone_count = p_skeleton->get_bone_count();
+	uint32_t hash = hash_murmur3_one_32(bone_count);
+	for (int bone = 0; bone < bone_count; bone++) {
+		hash = hash_murmur3_one_32(p_skeleton->get_bone_name(bone).hash(), hash);
+		hash = hash_murmur3_one_32(p_skeleton->get_bone_parent(bone), hash);
+		const Transform3D rest = p_skeleton->get_bone_rest(bone);
+		for (int axis = 0; axis < 3; axis++) {
+			hash = hash_murmur3_one_real(rest.basis.rows[axis].x, hash);
+			hash = hash_murmur3_one_real(rest.basis.rows[axis].y, hash);
+			hash = hash_murmur3_one_real(rest.basis.rows[axis].z, hash);
+			hash = hash_murmur3_one_real(rest.origin[axis], hash);
+		}
+	}
+	hash = hash_fmix32(hash);
+	// 0 marks an unbaked resource.
+	return hash ? hash : 1;
+}
+void VRMSpringBone::setup(VRMSpringBoneJoints &r_joints) {
+	if (!(!root_bones.is_empty() && skel)) {
+		return;
+	}
+	if (!baked_skeleton_hash) {
+		bake_joints(skel, skeleton_bake_hash(skel));
+	}
+	joint_offset = r_joints.size();
+	chain_offset = r_joints.chains.size();
+	const int32_t *bones = baked_joint_bones.ptr();
+	const int32_t *parents = baked_joint_parents.ptr();
+	const int32_t *depths = baked_joint_depths.ptr();
+	const Vector3 *tails = baked_joint_tails.ptr();
+	const int32_t baked_count = baked_joint_bones.size();
+	for (int32_t baked_i = 0; baked_i < baked_count;) {
+		VRMSpringBoneChain chain;
+		chain.spring_bone = this;
+		chain.joint_begin = r_joints.size();
+		chain.level_begin = r_joints.level_offsets.size();
+		// A chain runs up to the next root; a level ends where the depth changes.
+		do {
+			if (parents[baked_i] == -1 || depths[baked_i] != depths[baked_i - 1]) {
+				r_joints.level_offsets.push_back(r_joints.size());
+			}
+			const int32_t parent_joint = parents[baked_i] == -1 ? -1 : int32_t(joint_offset) + parents[baked_i];
+			setup_joint(r_joints, bones[baked_i], parent_joint, tails[baked_i]);
+			baked_i++;
+		} while (baked_i < baked_count && parents[baked_i] != -1);
+		r_joints.level_offsets.push_back(r_joints.size());
+		chain.joint_end = r_joints.size();
+		chain.level_count = r_joints.level_offsets.size() - chain.level_begin - 1;
+		r_joints.chains.push_back(chain);
+	}
+	joint_count = r_joints.size() - joint_offset;
+	chain_count = r_joints.chains.size() - chain_offset;
+}
+void VRMSpringBone::setup_joint(VRMSpringBoneJoints &r_joints, int id, int32_t parent_joint, const Vector3 &local_child_position) {
+	uint32_t joint = r_joints.add_joint(id, parent_joint);
+	Vector3 world_child_position = get_joint_transform(id).xform(local_child_position);
+	if (frame_has_center) {
+		r_joints.current_tail.set(joint, frame_center_inv.xform(world_child_position));
+	} else {
+		r_joints.current_tail.set(joint, world_child_position);
+	}
+	r_joints.prev_tail.set(joint, r_joints.current_tail.get(joint));
+	r_joints.bone_axis[joint] = local_child_position.normalized();
+	r_joints.length[joint] = local_child_position.length();
+	r_joints.radius[joint] = hit_radius;
+}
+void VRMSpringBone::reset_tails(VRMSpringBoneJoints &r_joints) {
+	if (!skel) {
+		return;
+	}
+	Transform3D center_transform;
+	const bool has_center = get_center_transform(nullptr, center_transform);
+	set_frame_center(has_center, center_transform);
+	const uint32_t joint_end = joint_offset + joint_count;
+	for (uint32_t joint_i = joint_offset; joint_i < joint_end; joint_i++) {
+		const Vector3 world_child_position = get_joint_transform(r_joints.bone_idx[joint_i]).xform(r_joints.bone_axis[joint_i] * r_joints.length[joint_i]);
+		r_joints.current_tail.set(joint_i, has_center ? frame_center_inv.xform(world_child_position) : world_child_position);
+		r_joints.prev_tail.set(joint_i, r_joints.current_tail.get(joint_i));
+	}
+}
+Transform3D VRMSpringBone::get_joint_transform(int bone_idx) const {
+	return skel->get_relative_transform(skel->get_parent()) * skel->get_bone_global_pose_no_override(bone_idx);
+}
+bool VRMSpringBone::get_center_transform(const VRMSkeletonPose *p_pose, Transform3D &r_transform) const {
+	if (center_bone_idx != -1) {
+		r_transform = p_pose ? p_pose->get_bone_transform(center_bone_idx) : get_joint_transform(center_bone_idx);
+		return true;
+	}
+	if (center_node_id.is_valid()) {
+		Node3D *center = Object::cast_to<Node3D>(ObjectDB::get_instance(center_node_id));
+		if (center) {
+			r_transform = center->get_relative_transform(skel->get_parent());
+			return true;
+		}
+	}
+	return false;
+}
+void VRMSpringBone::set_frame_center(bool p_has_center, const Transform3D &p_center) {
+	frame_has_center = p_has_center;
+	if (p_has_center) {
+		frame_center = p_center;
+		frame_center_inv = p_center.affine_inverse();
+	}
+}
+void VRMSpringBone::_ready(Skeleton3D *ready_skel, Node3D *p_center_node, const VRMColliderTable *p_collider_table, const LocalVector<uint64_t> &p_collider_group_mask, VRMSpringBoneJoints &r_joints) {
+	if (ready_skel) {
+		skel = ready_skel;
+	}
+	// The center is resolved once; the solver only sees a typed transform.
+	center_bone_idx = -1;
+	center_node_id = ObjectID();
+	if (skel && !center_bone.is_empty()) {
+		center_bone_idx = skel->find_bone(center_bone);
+		if (center_bone_idx == -1) {
+			WARN_PRINT(vformat("Ignoring spring bone center bone \"%s\", which is not in the skeleton.", center_bone));
+		}
+	} else if (p_center_node) {
+		center_node_id = p_center_node->get_instance_id();
+	}
+	if (skel) {
+		Transform3D center_transform;
+		const bool has_center = get_center_transform(nullptr, center_transform);
+		set_frame_center(has_center, center_transform);
+	}
+	setup(r_joints);
+	collider_table = p_collider_table;
+	collider_group_mask = p_collider_group_mask;
+	collider_count = 0;
+	for (uint32_t group_i = 0; group_i < collider_table->groups.size(); group_i++) {
+		if (VRMColliderTable::has_group(collider_group_mask, group_i)) {
+			collider_count += collider_table->groups[group_i]->collider_end - collider_table->groups[group_i]->collider_begin;
+		}
+	}
+	// Sized once here so cull_colliders() never reallocates for the avatar's
+	// own colliders. Interaction can grow it, it keeps its capacity.
+	chain_colliders.clear();
+	chain_colliders.reserve(collider_count * chain_count);
+}
+bool VRMSpringBone::prepare(double delta, VRMSpringBoneJoints &r_joints, const VRMSkeletonPose &p_pose) {
+	if (joint_count == 0) {
+		return false;
+	}
+	const uint32_t joint_end = joint_offset + joint_count;
+	Transform3D center_transform;
+	const bool has_center = get_center_transform(&p_pose, center_transform);
+	set_frame_center(has_center, center_transform);
+	frame_pose = &p_pose;
+	frame_skeleton_rotation_inv = p_pose.skeleton_rotation_inv;
+	frame_stiffness = stiffness_force * delta;
+	frame_external = gravity_dir * (gravity_power * delta);
+
+	// The animated origins bound the chains for the broadphase. The solver
+	// replaces them with the origins posed from the parent joints.
+	for (uint32_t joint_i = joint_offset; joint_i < joint_end; joint_i++) {
+		r_joints.origin.set(joint_i, p_pose.get_bone_transform(r_joints.bone_idx[joint_i]).origin);
+	}
+	frame_collider_motion = 0;
+	for (uint32_t group_i = 0; group_i < collider_table->groups.size(); group_i++) {
+		if (VRMColliderTable::has_group(collider_group_mask, group_i)) {
+			frame_collider_motion = MAX(frame_collider_motion, collider_table->groups[group_i]->frame_motion);
+		}
+	}
+	return true;
+}
+static bool _transform_moved(const Transform3D &p_from, const Transform3D &p_to, real_t p_threshold) {
+	const real_t threshold_squared = p_threshold * p_threshold;
+	if (p_from.origin.distance_squared_to(p_to.origin) > threshold_squared) {
+		return true;
+	}
+	for (int axis_i = 0; axis_i < 3; axis_i++) {
+		if (p_from.basis.get_column(axis_i).distance_squared_to(p_to.basis.get_column(axis_i)) > threshold_squared) {
+			return true;
+		}
+	}
+	return false;
+}
+void VRMSpringBone::update_sleep(VRMSpringBoneJoints &r_joints, int p_frames, real_t p_threshold) {
+	const real_t threshold_squared = p_threshold * p_threshold;
+	bool woken = sleep_wake || p_frames <= 0 || frame_collider_motion > p_threshold;
+	sleep_wake = false;
+	if (frame_has_center) {
+		woken = _transform_moved(sleep_center, frame_center, p_threshold) || woken;
+		sleep_center = frame_center;
+	}
+	const uint32_t chain_end = chain_offset + chain_count;
+	for (uint32_t chain_i = chain_offset; chain_i < chain_end; chain_i++) {
+		VRMSpringBoneChain &chain = r_joints.chains[chain_i];
+		const Transform3D root_transform = frame_pose->get_bone_transform(r_joints.bone_idx[chain.joint_begin]);
+		bool settled = !woken && !chain.interacting && !_transform_moved(chain.sleep_root_transform, root_transform, p_threshold);
+		chain.sleep_root_transform = root_transform;
+		for (uint32_t joint_i = chain.joint_begin; joint_i < chain.joint_end; joint_i++) {
+			const Vector3 origin = r_joints.origin.get(joint_i);
+			if (settled && (origin.distance_squared_to(r_joints.sleep_origin.get(joint_i)) > threshold_squared || r_joints.current_tail.get(joint_i).distance_squared_to(r_joints.prev_tail.get(joint_i)) > threshold_squared)) {
+				settled = false;
+			}
+			r_joints.sleep_origin.set(joint_i, origin);
+		}
+		chain.settled_frames = settled ? chain.settled_frames + 1 : 0;
+		chain.asleep = p_frames > 0 && chain.settled_frames >= uint32_t(p_frames);
+	}
+}
+void VRMSpringBone::update_chain_bounds(VRMSpringBoneJoints &r_joints) {
+	const uint32_t chain_end = chain_offset + chain_count;
+	for (uint32_t chain_i = chain_offset; chain_i < chain_end; chain_i++) {
+		VRMSpringBoneChain &chain = r_joints.chains[chain_i];
+		chain.bound_center = r_joints.origin.get(chain.joint_begin);
+		chain.bound_radius = 0;
+		for (uint32_t joint_i = chain.joint_begin; joint_i < chain.joint_end; joint_i++) {
+			const int32_t parent = r_joints.parent[joint_i];
+			r_joints.reach[joint_i] = parent == -1 ? 0 : r_joints.reach[parent] + r_joints.origin.get(parent).distance_to(r_joints.origin.get(joint_i));
+			chain.bound_radius = MAX(chain.bound_radius, r_joints.reach[joint_i] + r_joints.length[joint_i] + r_joints.radius[joint_i]);
+		}
+	}
+}
+void VRMSpringBone::cull_colliders(VRMSpringBoneJoints &r_joints) {
+	chain_colliders.clear();
+	frame_broadphase_tests = 0;
+	const uint32_t chain_end = chain_offset + chain_count;
+	for (uint32_t chain_i = chain_offset; chain_i < chain_end; chain_i++) {
+		VRMSpringBoneChain &chain = r_joints.chains[chain_i];
+		chain.collider_begin = chain_colliders.size();
+		chain.collider_end = chain.collider_begin;
+		if (chain.asleep) {
+			continue;
+		}
+		// Whole groups first, then the colliders of the groups that pass.
+		// Indices stay in ascending order, so hits resolve as without culling.
+		for (uint32_t group_i = 0; collider_count && group_i < collider_table->groups.size(); group_i++) {
+			const VRMColliderGroup *collider_group = collider_table->groups[group_i];
+			if (!VRMColliderTable::has_group(collider_group_mask, group_i) || collider_group->collider_begin == collider_group->collider_end) {
+				continue;
+			}
+			frame_broadphase_tests++;
+			const real_t group_reach = chain.bound_radius + collider_group->bound_radius;
+			if (chain.bound_center.distance_squared_to(collider_group->bound_center) > group_reach * group_reach) {
+				continue;
+			}
+			for (uint32_t collider_i = collider_group->collider_begin; collider_i < collider_group->collider_end; collider_i++) {
+				frame_broadphase_tests++;
+				if (collider_table->can_reach(collider_i, chain.bound_center, chain.bound_radius)) {
+					chain_colliders.push_back(collider_i);
+				}
+			}
+		}
+		// Other avatars' colliders, only gathered near interacting chains.
+		for (uint32_t collider_i = collider_table->external_begin; chain.interacting && collider_i < collider_table->size(); collider_i++) {
+			frame_broadphase_tests++;
+			if (collider_table->can_reach(collider_i, chain.bound_center, chain.bound_radius)) {
+				chain_colliders.push_back(collider_i);
+			}
+		}
+		chain.collider_end = chain_colliders.size();
+	}
+}
+void VRMSpringBone::pose_joints(VRMSpringBoneJoints &r_joints, uint32_t p_begin, uint32_t p_end) const {
+	for (uint32_t joint_i = p_begin; joint_i < p_end; joint_i++) {
+		const int32_t parent = r_joints.parent[joint_i];
+		const Transform3D joint_pose = parent == -1 ? r_joints.animated_pose[joint_i] : r_joints.solved_pose[parent] * r_joints.animated_pose[joint_i];
+		r_joints.solved_pose[joint_i] = joint_pose;
+		const Transform3D joint_tr = frame_pose->skeleton_transform * joint_pose;
+		const Quaternion rotation = joint_tr.basis.get_rotation_quaternion();
+		r_joints.rotation[joint_i] = rotation;
+		r_joints.origin.set(joint_i, joint_tr.origin);
+		r_joints.axis.set(joint_i, rotation.xform(r_joints.bone_axis[joint_i]));
+	}
+}
+template <bool p_has_center>
+void VRMSpringBone::integrate(VRMSpringBoneJoints &r_joints, const VRMSpringBoneChain &p_chain, uint32_t p_begin, uint32_t p_end) const {
+	if (p_has_center) {
+		r_joints.world_current_tail.set_xformed(r_joints.current_tail, frame_center, p_begin, p_end);
+		r_joints.world_prev_tail.set_xformed(r_joints.prev_tail, frame_center, p_begin, p_end);
+	}
+
+	VRMSpringBoneKernelArgs args;
+	args.current_tail = p_has_center ? &r_joints.world_current_tail : &r_joints.current_tail;
+	args.prev_tail = p_has_center ? &r_joints.world_prev_tail : &r_joints.prev_tail;
+	args.origin = &r_joints.origin;
+	args.axis = &r_joints.axis;
+	args.length = r_joints.length.ptr();
+	args.radius = r_joints.radius.ptr();
+	args.next_tail = &r_joints.next_tail;
+	args.collider_positions = &collider_table->positions;
+	args.collider_radii = collider_table->radii.ptr();
+	args.collider_tails = &collider_table->tails;
+	args.collider_shapes = collider_table->shapes.ptr();
+	args.collider_indices = chain_colliders.ptr() + p_chain.collider_begin;
+	args.collider_count = p_chain.collider_end - p_chain.collider_begin;
+	args.drag = drag_force;
+	args.stiffness = frame_stiffness;
+	args.external = frame_external;
+	_integrate_joints(args, p_begin, p_end);
+
+	// Record the tails for the next step.
+	if (p_has_center) {
+		r_joints.prev_tail.set_xformed(r_joints.world_current_tail, frame_center_inv, p_begin, p_end);
+		r_joints.current_tail.set_xformed(r_joints.next_tail, frame_center_inv, p_begin, p_end);
+	} else {
+		for (uint32_t joint_i = p_begin; joint_i < p_end; joint_i++) {
+			r_joints.prev_tail.set(joint_i, r_joints.current_tail.get(joint_i));
+			r_joints.current_tail.set(joint_i, r_joints.next_tail.get(joint_i));
+		}
+	}
+}
+template <bool p_has_center>
+void VRMSpringBone::resolve_rotations(VRMSpringBoneJoints &r_joints, uint32_t p_begin, uint32_t p_end, real_t p_alpha) const {
+	for (uint32_t joint_i = p_begin; joint_i < p_end; joint_i++) {
+		// The previous and current tails are the last two simulated states.
+		Vector3 tail = r_joints.prev_tail.get(joint_i).lerp(r_joints.current_tail.get(joint_i), p_alpha);
+		if (p_has_center) {
+			tail = frame_center.xform(tail);
+		}
+		Quaternion ft = VRMTopLevel::from_to_rotation(r_joints.axis.get(joint_i), tail - r_joints.origin.get(joint_i));
+		ft = frame_skeleton_rotation_inv * ft;
+		Transform3D &solved_pose = r_joints.solved_pose[joint_i];
+		solved_pose.basis = Basis((ft * r_joints.rotation[joint_i]).normalized(), solved_pose.basis.get_scale());
+	}
+}
+void VRMSpringBone::solve(VRMSpringBoneJoints &r_joints, const VRMSpringBoneChain &p_chain, uint32_t p_level_count, int p_substeps, real_t p_alpha) const {
+	if (frame_has_center) {
+		solve_levels<true>(r_joints, p_chain, p_level_count, p_substeps, p_alpha);
+	} else {
+		solve_levels<false>(r_joints, p_chain, p_level_count, p_substeps, p_alpha);
+	}
+}
+template <bool p_has_center>
+void VRMSpringBone::solve_levels(VRMSpringBoneJoints &r_joints, const VRMSpringBoneChain &p_chain, uint32_t p_level_count, int p_substeps, real_t p_alpha) const {
+	const uint32_t *level_offsets = r_joints.level_offsets.ptr() + p_chain.level_begin;
+	const uint32_t joint_end = level_offsets[p_level_count];
+	for (uint32_t joint_i = p_chain.joint_begin; joint_i < joint_end; joint_i++) {
+		const Transform3D &bone_pose = frame_pose->bone_global_poses[r_joints.bone_idx[joint_i]];
+		const int32_t parent = r_joints.parent[joint_i];
+		if (parent == -1) {
+			r_joints.animated_pose[joint_i] = bone_pose;
+		} else {
+			r_joints.animated_pose[joint_i] = frame_pose->bone_global_poses[r_joints.bone_idx[parent]].affine_inverse() * bone_pose;
+		}
+	}
+	// Each level hangs from the poses its parents were just solved to, so
+	// the levels run in order. The joints of one level are independent and
+	// go through the kernel together.
+	for (int substep_i = 0; substep_i < p_substeps; substep_i++) {
+		for (uint32_t level_i = 0; level_i < p_level_count; level_i++) {
+			pose_joints(r_joints, level_offsets[level_i], level_offsets[level_i + 1]);
+			integrate<p_has_center>(r_joints, p_chain, level_offsets[level_i], level_offsets[level_i + 1]);
+			resolve_rotations<p_has_center>(r_joints, level_offsets[level_i], level_offsets[level_i + 1], 1.0);
+		}
+	}
+	if (p_substeps == 0 || p_alpha < 1.0) {
+		// The last step posed the current tails, repose at the interpolated ones.
+		for (uint32_t level_i = 0; level_i < p_level_count; level_i++) {
+			pose_joints(r_joints, level_offsets[level_i], level_offsets[level_i + 1]);
+			resolve_rotations<p_has_center>(r_joints, level_offsets[level_i], level_offsets[level_i + 1], p_alpha);
+		}
+	}
+}
+void VRMSpringBone::apply(const VRMSpringBoneJoints &p_joints, VRMSkeletonPose &r_pose, real_t p_amount, bool p_roots_only) const {
+	const uint32_t joint_end = joint_offset + joint_count;
+	for (uint32_t joint_i = joint_offset; joint_i < joint_end; joint_i++) {
+		const int bone_idx = p_joints.bone_idx[joint_i];
+		if (p_roots_only && p_joints.parent[joint_i] != -1) {
+			r_pose.stage_override(bone_idx, r_pose.bone_global_poses[bone_idx], 0.0);
+			continue;
+		}
+		r_pose.stage_override(bone_idx, p_joints.solved_pose[joint_i], p_amount);
+	}
+}
+VRMSpringBoneServer *VRMSpringBoneServer::singleton = nullptr;
+
+VRMSpringBoneServer *VRMSpringBoneServer::get_singleton() {
+	return singleton;
+}
+
+RID VRMSpringBoneServer::avatar_create() {
+	Avatar *avatar = memnew(Avatar);
+	avatars.push_back(avatar);
+	setup_since_step = true;
+	return avatar_owner.make_rid(avatar);
+}
+
+void VRMSpringBoneServer::avatar_free(RID p_avatar) {
+	Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL(avatar);
+	// Its skeletons may already be deleted, so its pending async solve is
+	// waited for but never written back. The workers only read the chains.
+	for (uint32_t async_step_i = 0; async_step_i < 2; async_step_i++) {
+		async_steps[async_step_i].avatars.erase(avatar);
+	}
+	sync();
+	avatars.erase(avatar);
+	setup_since_step = true;
+	avatar_owner.free(p_avatar);
+	memdelete(avatar);
+}
+
+void VRMSpringBoneServer::avatar_setup(RID p_avatar, Node *p_owner, const Vector<Ref<VRMSpringBone>> &p_spring_bones, const Vector<Ref<VRMColliderGroup>> &p_collider_groups) {
+	Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL(avatar);
+	ERR_FAIL_NULL(p_owner);
+	sync();
+	setup_since_step = true;
+	avatar->collider_groups.clear();
+	avatar->spring_bones.clear();
+	avatar->joints.clear();
+	avatar->colliders.clear();
+	avatar->skeleton_poses.clear();
+	// Table group index of each source collider group. Spring bones
+	// reference the source groups.
+	HashMap<const VRMColliderGroup *, uint32_t> collider_group_indices;
+	for (Ref<VRMColliderGroup> collider_group : p_collider_groups) {
+		if (collider_group.is_null()) {
+			continue;
+		}
+		Ref<VRMColliderGroup> new_collider_group = collider_group->duplicate(true);
+		Node3D *parent = cast_to<Node3D>(p_owner->get_node_or_null(new_collider_group->skeleton_or_node));
+		if (parent) {
+			collider_group_indices.insert(collider_group.ptr(), avatar->colliders.groups.size());
+			new_collider_group->_ready(parent, avatar->colliders);
+			// Groups on a plain node read its transform in _process().
+			if (new_collider_group->bone_idx != -1) {
+				new_collider_group->skeleton_pose = _get_skeleton_pose(avatar, new_collider_group->skel);
+				avatar->skeleton_poses[new_collider_group->skeleton_pose].track_bone(new_collider_group->bone_idx);
+			}
+			avatar->collider_groups.append(new_collider_group);
+		}
+	}
+	avatar->colliders.external_begin = avatar->colliders.size();
+	LocalVector<uint64_t> collider_group_mask;
+	// Every spring bone of a skeleton shares its bake key.
+	HashMap<const Skeleton3D *, uint32_t> skeleton_hashes;
+	for (Ref<VRMSpringBone> spring_bone : p_spring_bones) {
+		if (spring_bone.is_null()) {
+			continue;
+		}
+		Skeleton3D *skel = cast_to<Skeleton3D>(p_owner->get_node_or_null(spring_bone->skeleton));
+		if (skel) {
+			const uint32_t *skeleton_hash = skeleton_hashes.getptr(skel);
+			if (!skeleton_hash) {
+				skeleton_hash = &skeleton_hashes.insert(skel, VRMSpringBone::skeleton_bake_hash(skel))->value;
+			}
+			if (!spring_bone->is_baked_for(*skeleton_hash)) {
+				// Bake into the shared resource so later avatars only copy.
+				// The baked arrays are not serialized.
+				spring_bone->bake_joints(skel, *skeleton_hash);
+			}
+		}
+		Ref<VRMSpringBone> new_spring_bone = spring_bone->duplicate(true);
+		collider_group_mask.clear();
+		collider_group_mask.resize((avatar->colliders.groups.size() + 63) / 64);
+		for (uint32_t word_i = 0; word_i < collider_group_mask.size(); word_i++) {
+			collider_group_mask[word_i] = 0;
+		}
+		for (int32_t group_i = 0; group_i < new_spring_bone->collider_groups.size(); group_i++) {
+			const Ref<VRMColliderGroup> collider_group = new_spring_bone->collider_groups[group_i];
+			const uint32_t *table_group = collider_group.is_valid() ? collider_group_indices.getptr(collider_group.ptr()) : nullptr;
+			if (table_group) {
+				collider_group_mask[*table_group >> 6] |= uint64_t(1) << (*table_group & 63);
+			}
+		}
+		if (skel) {
+			Node3D *center_node = nullptr;
+			if (!new_spring_bone->center_node.is_empty()) {
+				center_node = cast_to<Node3D>(p_owner->get_node_or_null(new_spring_bone->center_node));
+			}
+			new_spring_bone->_ready(skel, center_node, &avatar->colliders, collider_group_mask, avatar->joints);
+			new_spring_bone->skeleton_pose = _get_skeleton_pose(avatar, skel);
+			VRMSkeletonPose &pose = avatar->skeleton_poses[new_spring_bone->skeleton_pose];
+			pose.track_bone(new_spring_bone->center_bone_idx);
+			const uint32_t joint_end = new_spring_bone->joint_offset + new_spring_bone->joint_count;
+			for (uint32_t joint_i = new_spring_bone->joint_offset; joint_i < joint_end; joint_i++) {
+				pose.track_bone(avatar->joints.bone_idx[joint_i]);
+				pose.track_override_bone(avatar->joints.bone_idx[joint_i]);
+			}
+			avatar->spring_bones.append(new_spring_bone);
+		}
+	}
+	_store_written_tails(avatar);
+}
+
+int32_t VRMSpringBoneServer::_get_skeleton_pose(Avatar *p_avatar, Skeleton3D *p_skeleton) {
+	for (uint32_t pose_i = 0; pose_i < p_avatar->skeleton_poses.size(); pose_i++) {
+		if (p_avatar->skeleton_poses[pose_i].skeleton == p_skeleton) {
+			return pose_i;
+		}
+	}
+	VRMSkeletonPose pose;
+	pose.skeleton = p_skeleton;
+	pose.skeleton_id = p_skeleton->get_instance_id();
+	p_avatar->skeleton_poses.push_back(pose);
+	return p_avatar->skeleton_poses.size() - 1;
+}
+
+void VRMSpringBoneServer::avatar_set_active(RID p_avatar, bool p_active) {
+	Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL(avatar);
+	// Called every frame by VRMSecondary, only a change has to wait.
+	if (avatar->active == p_active) {
+		return;
+	}
+	sync();
+	avatar->active = p_active;
+}
+
+bool VRMSpringBoneServer::avatar_is_active(RID p_avatar) const {
+	const Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL_V(avatar, false);
+	return avatar->active;
+}
+
+void VRMSpringBoneServer::avatar_set_physics_process(RID p_avatar, bool p_physics_process) {
+	Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL(avatar);
+	sync();
+	avatar->physics_process = p_physics_process;
+}
+
+void VRMSpringBoneServer::avatar_set_update_mode(RID p_avatar, VRMTopLevel::SpringBoneUpdateMode p_mode, int p_parallel_min_joints) {
+	Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL(avatar);
+	sync();
+	avatar->update_mode = p_mode;
+	avatar->parallel_min_joints = p_parallel_min_joints;
+}
+
+void VRMSpringBoneServer::avatar_set_fixed_step(RID p_avatar, int p_step_rate, int p_max_substeps) {
+	Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL(avatar);
+	sync();
+	avatar->fixed_step_rate = MAX(p_step_rate, 0);
+	avatar->max_substeps = MAX(p_max_substeps, 1);
+	avatar->step_accumulator = 0.0;
+}
+
+void VRMSpringBoneServer::avatar_set_lod(RID p_avatar, VRMTopLevel::SpringBoneLOD p_lod) {
+	Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL(avatar);
+	sync();
+	if (avatar->trace_mode != TRACE_NONE) {
+		// Traces hold every frame at full detail.
+		avatar->trace_lod = p_lod;
+		return;
+	}
+	_set_lod(avatar, p_lod);
+}
+
+void VRMSpringBoneServer::_set_lod(Avatar *avatar, VRMTopLevel::SpringBoneLOD p_lod) {
+	if (p_lod == VRMTopLevel::SPRING_BONE_LOD_FROZEN && avatar->lod != VRMTopLevel::SPRING_BONE_LOD_FROZEN) {
+		// The overrides are skeleton space poses; held while frozen they would
+		// pin the chains in place as the animation moves the body.
+		for (uint32_t pose_i = 0; pose_i < avatar->skeleton_poses.size(); pose_i++) {
+			avatar->skeleton_poses[pose_i].release_overrides();
+		}
+	}
+	if (p_lod < avatar->lod && avatar->lod >= VRMTopLevel::SPRING_BONE_LOD_ROOT_ONLY) {
+		// Tails that were not simulated are stale. Drop their velocity and fade
+		// the simulation back in rather than snapping. Frozen tails are far
+		// behind the animation, they restart from it.
+		VRMSpringBoneJoints &joints = avatar->joints;
+		if (avatar->lod == VRMTopLevel::SPRING_BONE_LOD_FROZEN) {
+			for (const Ref<VRMSpringBone> &spring_bone : avatar->spring_bones) {
+				spring_bone->reset_tails(joints);
+			}
+		} else {
+			for (uint32_t joint_i = 0; joint_i < joints.size(); joint_i++) {
+				joints.prev_tail.set(joint_i, joints.current_tail.get(joint_i));
+			}
+		}
+		avatar->lod_blend = 0.0;
+	}
+	if (p_lod != avatar->lod) {
+		for (const Ref<VRMSpringBone> &spring_bone : avatar->spring_bones) {
+			spring_bone->sleep_wake = true;
+		}
+	}
+	avatar->lod = p_lod;
+	avatar->lod_skipped_delta = 0.0;
+}
+
+VRMTopLevel::SpringBoneLOD VRMSpringBoneServer::avatar_get_lod(RID p_avatar) const {
+	const Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL_V(avatar, VRMTopLevel::SPRING_BONE_LOD_FULL);
+	return avatar->lod;
+}
+
+void VRMSpringBoneServer::avatar_set_lod_blend_time(RID p_avatar, real_t p_blend_time) {
+	Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL(avatar);
+	sync();
+	avatar->lod_blend_time = p_blend_time;
+}
+
+void VRMSpringBoneServer::avatar_set_sleep(RID p_avatar, int p_frames, real_t p_threshold) {
+	Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL(avatar);
+	sync();
+	avatar->sleep_frames = MAX(p_frames, 0);
+	avatar->sleep_threshold = MAX(p_threshold, real_t(0.0));
+}
+
+void VRMSpringBoneServer::avatar_set_interaction(RID p_avatar, bool p_interaction) {
+	Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL(avatar);
+	sync();
+	avatar->interaction = p_interaction;
+}
+
+void VRMSpringBoneServer::avatar_wake(RID p_avatar) {
+	Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL(avatar);
+	sync();
+	for (const Ref<VRMSpringBone> &spring_bone : avatar->spring_bones) {
+		spring_bone->sleep_wake = true;
+	}
+}
+
+// "VRMT", followed by the format version.
+static const uint32_t VRM_SPRING_BONE_TRACE_MAGIC = 0x544D5256;
+static const uint32_t VRM_SPRING_BONE_TRACE_VERSION = 2;
+
+static void _store_trace_transform(FileAccess *p_file, const Transform3D &p_transform) {
+	for (int row_i = 0; row_i < 3; row_i++) {
+		p_file->store_real(p_transform.basis.rows[row_i].x);
+		p_file->store_real(p_transform.basis.rows[row_i].y);
+		p_file->store_real(p_transform.basis.rows[row_i].z);
+	}
+	p_file->store_real(p_transform.origin.x);
+	p_file->store_real(p_transform.origin.y);
+	p_file->store_real(p_transform.origin.z);
+}
+
+static Transform3D _get_trace_transform(FileAccess *p_file) {
+	Transform3D transform;
+	for (int row_i = 0; row_i < 3; row_i++) {
+		transform.basis.rows[row_i].x = p_file->get_real();
+		transform.basis.rows[row_i].y = p_file->get_real();
+		transform.basis.rows[row_i].z = p_file->get_real();
+	}
+	transform.origin.x = p_file->get_real();
+	transform.origin.y = p_file->get_real();
+	transform.origin.z = p_file->get_real();
+	return transform;
+}
+
+void VRMSpringBoneServer::_store_trace_layout(Avatar *p_avatar) {
+	FileAccess *file = p_avatar->trace.ptr();
+	file->store_32(VRM_SPRING_BONE_TRACE_MAGIC);
+	file->store_32(VRM_SPRING_BONE_TRACE_VERSION);
+	// Reals are stored at the build's precision.
+	file->store_8(sizeof(real_t));
+	file->store_32(p_avatar->skeleton_poses.size());
+	for (uint32_t pose_i = 0; pose_i < p_avatar->skeleton_poses.size(); pose_i++) {
+		const VRMSkeletonPose &pose = p_avatar->skeleton_poses[pose_i];
+		file->store_32(pose.bones.size());
+		for (uint32_t bone_i = 0; bone_i < pose.bones.size(); bone_i++) {
+			file->store_32(pose.bones[bone_i]);
+		}
+	}
+	file->store_32(p_avatar->spring_bones.size());
+	// The solver state the trace starts from.
+	const VRMSpringBoneJoints &joints = p_avatar->joints;
+	file->store_32(joints.size());
+	for (uint32_t joint_i = 0; joint_i < joints.size(); joint_i++) {
+		const Vector3 current_tail = joints.current_tail.get(joint_i);
+		const Vector3 prev_tail = joints.prev_tail.get(joint_i);
+		file->store_real(current_tail.x);
+		file->store_real(current_tail.y);
+		file->store_real(current_tail.z);
+		file->store_real(prev_tail.x);
+		file->store_real(prev_tail.y);
+		file->store_real(prev_tail.z);
+	}
+	file->store_double(p_avatar->step_accumulator);
+}
+
+Error VRMSpringBoneServer::_load_trace_layout(Avatar *p_avatar) {
+	FileAccess *file = p_avatar->trace.ptr();
+	ERR_FAIL_COND_V_MSG(file->get_32() != VRM_SPRING_BONE_TRACE_MAGIC, ERR_FILE_UNRECOGNIZED, "Not a VRM spring bone trace.");
+	ERR_FAIL_COND_V_MSG(file->get_32() != VRM_SPRING_BONE_TRACE_VERSION, ERR_FILE_UNRECOGNIZED, "Unsupported VRM spring bone trace version.");
+	ERR_FAIL_COND_V_MSG(file->get_8() != sizeof(real_t), ERR_FILE_UNRECOGNIZED, "The trace was recorded by a build with a different floating point precision.");
+	ERR_FAIL_COND_V_MSG(file->get_32() != p_avatar->skeleton_poses.size(), ERR_INVALID_DATA, "The trace was recorded from a different avatar.");
+	for (uint32_t pose_i = 0; pose_i < p_avatar->skeleton_poses.size(); pose_i++) {
+		const VRMSkeletonPose &pose = p_avatar->skeleton_poses[pose_i];
+		ERR_FAIL_COND_V_MSG(file->get_32() != pose.bones.size(), ERR_INVALID_DATA, "The trace was recorded from a different avatar.");
+		for (uint32_t bone_i = 0; bone_i < pose.bones.size(); bone_i++) {
+			ERR_FAIL_COND_V_MSG(int32_t(file->get_32()) != pose.bones[bone_i], ERR_INVALID_DATA, "The trace was recorded from a different avatar.");
+		}
+	}
+	ERR_FAIL_COND_V_MSG(file->get_32() != uint32_t(p_avatar->spring_bones.size()), ERR_INVALID_DATA, "The trace was recorded from a different avatar.");
+	VRMSpringBoneJoints &joints = p_avatar->joints;
+	ERR_FAIL_COND_V_MSG(file->get_32() != joints.size(), ERR_INVALID_DATA, "The trace was recorded from a different avatar.");
+	for (uint32_t joint_i = 0; joint_i < joints.size(); joint_i++) {
+		Vector3 current_tail;
+		current_tail.x = file->get_real();
+		current_tail.y = file->get_real();
+		current_tail.z = file->get_real();
+		Vector3 prev_tail;
+		prev_tail.x = file->get_real();
+		prev_tail.y = file->get_real();
+		prev_tail.z = file->get_real();
+		joints.current_tail.set(joint_i, current_tail);
+		joints.prev_tail.set(joint_i, prev_tail);
+	}
+	p_avatar->step_accumulator = file->get_double();
+	return OK;
+}
+
+void VRMSpringBoneServer::_store_trace_frame(Avatar *p_avatar, double p_delta) {
+	FileAccess *file = p_avatar->trace.ptr();
+	file->store_double(p_delta);
+	for (uint32_t pose_i = 0; pose_i < p_avatar->skeleton_poses.size(); pose_i++) {
+		const VRMSkeletonPose &pose = p_avatar->skeleton_poses[pose_i];
+		_store_trace_transform(file, pose.skeleton_transform);
+		for (uint32_t bone_i = 0; bone_i < pose.bones.size(); bone_i++) {
+			_store_trace_transform(file, pose.bone_global_poses[pose.bones[bone_i]]);
+		}
+	}
+}
+
+bool VRMSpringBoneServer::_load_trace_frame(Avatar *p_avatar, double &r_delta) {
+	FileAccess *file = p_avatar->trace.ptr();
+	if (file->get_position() >= file->get_length()) {
+		return false;
+	}
+	r_delta = file->get_double();
+	for (uint32_t pose_i = 0; pose_i < p_avatar->skeleton_poses.size(); pose_i++) {
+		VRMSkeletonPose &pose = p_avatar->skeleton_poses[pose_i];
+		pose.skeleton_transform = _get_trace_transform(file);
+		pose.skeleton_rotation_inv = pose.skeleton_transform.basis.get_rotation_quaternion().inverse();
+		for (uint32_t bone_i = 0; bone_i < pose.bones.size(); bone_i++) {
+			pose.bone_global_poses[pose.bones[bone_i]] = _get_trace_transform(file);
+		}
+	}
+	return !file->eof_reached();
+}
+
+void VRMSpringBoneServer::_store_trace_centers(Avatar *p_avatar) {
+	FileAccess *file = p_avatar->trace.ptr();
+	for (const Ref<VRMSpringBone> &spring_bone : p_avatar->spring_bones) {
+		file->store_8(spring_bone->frame_has_center);
+		if (spring_bone->frame_has_center) {
+			_store_trace_transform(file, spring_bone->frame_center);
+		}
+	}
+}
+
+void VRMSpringBoneServer::_load_trace_centers(Avatar *p_avatar) {
+	FileAccess *file = p_avatar->trace.ptr();
+	for (const Ref<VRMSpringBone> &spring_bone : p_avatar->spring_bones) {
+		const bool has_center = file->get_8();
+		spring_bone->set_frame_center(has_center, has_center ? _get_trace_transform(file) : Transform3D());
+	}
+}
+
+Error VRMSpringBoneServer::avatar_trace_record(RID p_avatar, const String &p_path) {
+	Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL_V(avatar, ERR_INVALID_PARAMETER);
+	avatar_trace_stop(p_avatar);
+	Error err = OK;
+	avatar->trace = FileAccess::open(p_path, FileAccess::WRITE, &err);
+	ERR_FAIL_COND_V_MSG(err != OK, err, vformat("Cannot open \"%s\" to record a spring bone trace.", p_path));
+	avatar->trace_lod = avatar->lod;
+	_set_lod(avatar, VRMTopLevel::SPRING_BONE_LOD_FULL);
+	avatar->lod_blend = 1.0;
+	_store_trace_layout(avatar);
+	avatar->trace_mode = TRACE_RECORD;
+	return OK;
+}
+
+Error VRMSpringBoneServer::avatar_trace_replay(RID p_avatar, const String &p_path, const String &p_output_path) {
+	Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL_V(avatar, ERR_INVALID_PARAMETER);
+	avatar_trace_stop(p_avatar);
+	Error err = OK;
+	avatar->trace = FileAccess::open(p_path, FileAccess::READ, &err);
+	ERR_FAIL_COND_V_MSG(err != OK, err, vformat("Cannot open the spring bone trace \"%s\".", p_path));
+	// Switch before loading, a thaw would overwrite the recorded tails.
+	avatar->trace_lod = avatar->lod;
+	_set_lod(avatar, VRMTopLevel::SPRING_BONE_LOD_FULL);
+	avatar->lod_blend = 1.0;
+	err = _load_trace_layout(avatar);
+	if (err != OK) {
+		_end_trace(avatar);
+		return err;
+	}
+	if (!p_output_path.is_empty()) {
+		avatar->trace_output = FileAccess::open(p_output_path, FileAccess::WRITE, &err);
+		if (err != OK) {
+			_end_trace(avatar);
+			ERR_FAIL_V_MSG(err, vformat("Cannot open \"%s\" to write the replay output.", p_output_path));
+		}
+	}
+	avatar->trace_mode = TRACE_REPLAY;
+	return OK;
+}
+
+void VRMSpringBoneServer::avatar_trace_stop(RID p_avatar) {
+	Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL(avatar);
+	sync();
+	if (avatar->trace_mode != TRACE_NONE) {
+		_end_trace(avatar);
+	}
+}
+
+void VRMSpringBoneServer::_end_trace(Avatar *p_avatar) {
+	p_avatar->trace_mode = TRACE_NONE;
+	p_avatar->trace.unref();
+	p_avatar->trace_output.unref();
+	_set_lod(p_avatar, p_avatar->trace_lod);
+}
+
+VRMSpringBoneServer::TraceMode VRMSpringBoneServer::avatar_get_trace_mode(RID p_avatar) const {
+	const Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL_V(avatar, TRACE_NONE);
+	return avatar->trace_mode;
+}
+
+void VRMSpringBoneServer::avatar_clear_poses(RID p_avatar) {
+	Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL(avatar);
+	sync();
+	for (Ref<VRMSpringBone> spring_bone : avatar->spring_bones) {
+		// The editor can free or replace the skeleton before it clears.
+		const VRMSkeletonPose &pose = avatar->skeleton_poses[spring_bone->skeleton_pose];
+		if (ObjectDB::get_instance(pose.skeleton_id)) {
+			pose.skeleton->clear_bones_global_pose_override();
+		}
+	}
+}
+
+int VRMSpringBoneServer::avatar_get_spring_bone_count(RID p_avatar) const {
+	const Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL_V(avatar, 0);
+	return avatar->spring_bones.size();
+}
+
+void VRMSpringBoneServer::avatar_set_spring_bone_param(RID p_avatar, int p_spring_bone, SpringBoneParam p_param, real_t p_value) {
+	Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL(avatar);
+	sync();
+	ERR_FAIL_INDEX(p_spring_bone, avatar->spring_bones.size());
+	const Ref<VRMSpringBone> &spring_bone = avatar->spring_bones[p_spring_bone];
+	spring_bone->sleep_wake = true;
+	switch (p_param) {
+		case SPRING_BONE_PARAM_STIFFNESS: {
+			spring_bone->stiffness_force = p_value;
+		} break;
+		case SPRING_BONE_PARAM_GRAVITY_POWER: {
+			spring_bone->gravity_power = p_value;
+		} break;
+		case SPRING_BONE_PARAM_DRAG: {
+			spring_bone->drag_force = p_value;
+		} break;
+		case SPRING_BONE_PARAM_HIT_RADIUS: {
+			spring_bone->hit_radius = p_value;
+			const uint32_t joint_end = spring_bone->joint_offset + spring_bone->joint_count;
+			for (uint32_t joint_i = spring_bone->joint_offset; joint_i < joint_end; joint_i++) {
+				avatar->joints.radius[joint_i] = p_value;
+			}
+		} break;
+	}
+}
+
+real_t VRMSpringBoneServer::avatar_get_spring_bone_param(RID p_avatar, int p_spring_bone, SpringBoneParam p_param) const {
+	const Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL_V(avatar, 0);
+	ERR_FAIL_INDEX_V(p_spring_bone, avatar->spring_bones.size(), 0);
+	const Ref<VRMSpringBone> &spring_bone = avatar->spring_bones[p_spring_bone];
+	switch (p_param) {
+		case SPRING_BONE_PARAM_STIFFNESS:
+			return spring_bone->stiffness_force;
+		case SPRING_BONE_PARAM_GRAVITY_POWER:
+			return spring_bone->gravity_power;
+		case SPRING_BONE_PARAM_DRAG:
+			return spring_bone->drag_force;
+		case SPRING_BONE_PARAM_HIT_RADIUS:
+			return spring_bone->hit_radius;
+	}
+	return 0;
+}
+
+void VRMSpringBoneServer::avatar_set_spring_bone_gravity_dir(RID p_avatar, int p_spring_bone, const Vector3 &p_gravity_dir) {
+	Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL(avatar);
+	sync();
+	ERR_FAIL_INDEX(p_spring_bone, avatar->spring_bones.size());
+	avatar->spring_bones[p_spring_bone]->gravity_dir = p_gravity_dir;
+	avatar->spring_bones[p_spring_bone]->sleep_wake = true;
+}
+
+Vector3 VRMSpringBoneServer::avatar_get_spring_bone_gravity_dir(RID p_avatar, int p_spring_bone) const {
+	const Avatar *avatar = avatar_owner.get_or_null(p_avatar);
+	ERR_FAIL_NULL_V(avatar, Vector3());
+	ERR_FAIL_INDEX_V(p_spring_bone, avatar->spring_bones.size(), Vector3());
+	return avatar->spring_bones[p_spring_bone]->gravity_dir;
+}
+
+const VRMSpringBoneServer::Avatar *VRMSpringBoneServer::avatar_get(RID p_avatar) const {
+	return avatar_owner.get_or_null(p_avatar);
+}
+
+void VRMSpringBoneServer::_solve_avatar_chain(Avatar *p_avatar, uint32_t p_chain) {
+	const VRMSpringBoneChain &chain = p_avatar->joints.chains[p_chain];
+	if (chain.asleep) {
+		return;
+	}
+	// The root only tier simulates the first joint of each chain.
+	const uint32_t level_count = p_avatar->lod == VRMTopLevel::SPRING_BONE_LOD_ROOT_ONLY ? 1 : chain.level_count;
+	chain.spring_bone->solve(p_avatar->joints, chain, level_count, p_avatar->frame_substeps, p_avatar->frame_alpha);
+}
+
+void VRMSpringBoneServer::_solve_chain(void *p_chains, uint32_t p_index) {
+	const StepChain *chains = static_cast<const StepChain *>(p_chains);
+	_solve_avatar_chain(chains[p_index].avatar, chains[p_index].chain);
+}
+
+void VRMSpringBoneServer::step(double p_delta, bool p_physics_process) {
+	uint64_t frame = p_physics_process ? Engine::get_singleton()->get_physics_frames() : Engine::get_singleton()->get_process_frames();
+	uint64_t &last_frame = p_physics_process ? last_physics_frame : last_process_frame;
+	if (last_frame == frame) {
+		return;
+	}
+	last_frame = frame;
+	if (!monitors_registered) {
+		// Performance is created after the modules, so register on first use.
+		register_monitors();
+	}
+	_step(p_delta, p_physics_process);
+}
+
+static uint32_t _hash_storage(const void *p_ptr, uint32_t p_hash) {
+	return hash_murmur3_one_64(uint64_t(uintptr_t(p_ptr)), p_hash);
+}
+
+uint32_t VRMSpringBoneServer::_get_avatar_storage_hash(const Avatar *p_avatar) {
+	const VRMColliderTable &colliders = p_avatar->colliders;
+	uint32_t hash = HASH_MURMUR3_SEED;
+	hash = _hash_storage(colliders.positions.x.ptr(), hash);
+	hash = _hash_storage(colliders.positions.y.ptr(), hash);
+	hash = _hash_storage(colliders.positions.z.ptr(), hash);
+	hash = _hash_storage(colliders.tails.x.ptr(), hash);
+	hash = _hash_storage(colliders.tails.y.ptr(), hash);
+	hash = _hash_storage(colliders.tails.z.ptr(), hash);
+	hash = _hash_storage(colliders.radii.ptr(), hash);
+	hash = _hash_storage(colliders.shapes.ptr(), hash);
+	for (const Ref<VRMSpringBone> &spring_bone : p_avatar->spring_bones) {
+		hash = _hash_storage(spring_bone->chain_colliders.ptr(), hash);
+	}
+	for (uint32_t pose_i = 0; pose_i < p_avatar->skeleton_poses.size(); pose_i++) {
+		const VRMSkeletonPose &pose = p_avatar->skeleton_poses[pose_i];
+		hash = _hash_storage(pose.capture_bones.ptr(), hash);
+		hash = _hash_storage(pose.capture_parents.ptr(), hash);
+		hash = _hash_storage(pose.bone_global_poses.ptr(), hash);
+		hash = _hash_storage(pose.bone_overrides.ptr(), hash);
+		hash = _hash_storage(pose.bone_override_amounts.ptr(), hash);
+	}
+	return hash_fmix32(hash);
+}
+
+void VRMSpringBoneServer::_step(double p_delta, bool p_physics_process) {
+	// Gather every avatar on this thread: skeleton and scene reads are not thread safe.
+	// The step lists keep their capacity, so they stop reallocating after warm-up.
+	step_avatars.clear();
+	step_chains.clear();
+	pose_query_count = 0;
+	broadphase_test_count = 0;
+	sleeping_chain_count = 0;
+	collision_pair_count = 0;
+	collision_pair_count_unculled = 0;
+	frame_joint_count = 0;
+	frame_collider_count = 0;
+	collider_update_usec = 0;
+	integration_usec = 0;
+	write_back_usec = 0;
+	gizmo_draw_usec = 0;
+	frame_avatar_count = 0;
+	interaction_collider_count = 0;
+	// The async solve started by the previous step worked from that step's
+	// poses; write it back before anything reads or changes the avatars.
+	AsyncStep &async_step = async_steps[p_physics_process];
+	_finish_async_step(async_step, true);
+	async_step.avatars.clear();
+	async_step.chains.clear();
+	const Avatar *const *step_avatars_storage = step_avatars.ptr();
+	const StepChain *step_chains_storage = step_chains.ptr();
+	const Avatar *const *async_avatars_storage = async_step.avatars.ptr();
+	const StepChain *async_chains_storage = async_step.chains.ptr();
+	const Avatar *const *prepared_avatars_storage = prepared_avatars.ptr();
+	const InteractionCollider *interaction_colliders_storage = interaction_colliders.ptr();
+	const InteractionCell *interaction_cells_storage = interaction_cells.ptr();
+	const uint32_t *interaction_large_colliders_storage = interaction_large_colliders.ptr();
+	prepared_avatars.clear();
+	for (uint32_t avatar_i = 0; avatar_i < avatars.size(); avatar_i++) {
+		Avatar *avatar = avatars[avatar_i];
+		if (!avatar->active || avatar->physics_process != p_physics_process) {
+			continue;
+		}
+		double avatar_delta = p_delta;
+		if (avatar->trace_mode == TRACE_REPLAY && !_load_trace_frame(avatar, avatar_delta)) {
+			// End of the trace, back to the live scene.
+			_end_trace(avatar);
+			avatar_delta = p_delta;
+		}
+		// Frozen avatars keep their last pose. Reduced rate tiers skip frames
+		// and hand the skipped time to the next step they take.
+		if (avatar->lod == VRMTopLevel::SPRING_BONE_LOD_FROZEN) {
+			continue;
+		}
+		const uint32_t lod_interval = avatar->lod == VRMTopLevel::SPRING_BONE_LOD_QUARTER_RATE ? 4 : (avatar->lod == VRMTopLevel::SPRING_BONE_LOD_HALF_RATE ? 2 : 1);
+		avatar->lod_frame++;
+		if (avatar->lod_frame % lod_interval) {
+			avatar->lod_skipped_delta += avatar_delta;
+			continue;
+		}
+		const double frame_delta = avatar_delta + avatar->lod_skipped_delta;
+		avatar->lod_skipped_delta = 0.0;
+		if (avatar->lod_blend < 1.0) {
+			avatar->lod_blend = avatar->lod_blend_time > 0.0 ? MIN(avatar->lod_blend + real_t(frame_delta / avatar->lod_blend_time), real_t(1.0)) : real_t(1.0);
+		}
+		// In fixed step mode the solver runs whole steps out of an accumulator
+		// and the displayed pose is interpolated between the last two.
+		double step_delta = frame_delta;
+		avatar->frame_substeps = 1;
+		avatar->frame_alpha = 1.0;
+		if (avatar->fixed_step_rate > 0) {
+			step_delta = 1.0 / avatar->fixed_step_rate;
+			avatar->step_accumulator += frame_delta;
+			avatar->frame_substeps = MIN(int(avatar->step_accumulator / step_delta), avatar->max_substeps);
+			avatar->step_accumulator -= avatar->frame_substeps * step_delta;
+			if (avatar->step_accumulator >= step_delta) {
+				// Dropped steps past max_substeps; keep the remainder of one step.
+				avatar->step_accumulator = Math::fmod(avatar->step_accumulator, step_delta);
+			}
+			avatar->frame_alpha = avatar->step_accumulator / step_delta;
+		}
+		// The first query of a dirty skeleton updates it, the rest only read.
+		// A replay already loaded the poses from the trace.
+		if (avatar->trace_mode != TRACE_REPLAY) {
+			for (uint32_t pose_i = 0; pose_i < avatar->skeleton_poses.size(); pose_i++) {
+				pose_query_count += avatar->skeleton_poses[pose_i].capture();
+			}
+		}
+		if (avatar->trace_mode == TRACE_RECORD) {
+			_store_trace_frame(avatar, avatar_delta);
+		}
+		uint64_t begin_usec = OS::get_singleton()->get_ticks_usec();
+		for (const Ref<VRMColliderGroup> &collider_group : avatar->collider_groups) {
+			const VRMSkeletonPose *pose = collider_group->skeleton_pose != -1 ? &avatar->skeleton_poses[collider_group->skeleton_pose] : nullptr;
+			collider_group->_process(pose, avatar->colliders);
+			frame_collider_count += collider_group->collider_end - collider_group->collider_begin;
+		}
+		collider_update_usec += OS::get_singleton()->get_ticks_usec() - begin_usec;
+		bool prepared = false;
+		for (const Ref<VRMSpringBone> &spring_bone : avatar->spring_bones) {
+			prepared = spring_bone->prepare(step_delta, avatar->joints, avatar->skeleton_poses[spring_bone->skeleton_pose]) || prepared;
+		}
+		if (avatar->trace_mode == TRACE_RECORD) {
+			_store_trace_centers(avatar);
+		} else if (avatar->trace_mode == TRACE_REPLAY) {
+			_load_trace_centers(avatar);
+		}
+		if (!prepared) {
+			continue;
+		}
+		if (avatar->interaction) {
+			_update_interaction_space(avatar);
+		}
+		prepared_avatars.push_back(avatar);
+	}
+
+	// Every avatar's colliders are final now, so other avatars can collide
+	// with them.
+	_build_interaction_grid();
+
+	for (uint32_t avatar_i = 0; avatar_i < prepared_avatars.size(); avatar_i++) {
+		Avatar *avatar = prepared_avatars[avatar_i];
+		for (const Ref<VRMSpringBone> &spring_bone : avatar->spring_bones) {
+			if (spring_bone->joint_count) {
+				spring_bone->update_chain_bounds(avatar->joints);
+			}
+		}
+		_gather_interaction_colliders(avatar);
+		// Runs after the centers are final so a replay sleeps like the recording.
+		for (const Ref<VRMSpringBone> &spring_bone : avatar->spring_bones) {
+			if (spring_bone->joint_count) {
+				spring_bone->update_sleep(avatar->joints, avatar->sleep_frames, avatar->sleep_threshold);
+				spring_bone->cull_colliders(avatar->joints);
+			}
+			broadphase_test_count += spring_bone->frame_broadphase_tests;
+		}
+		const uint32_t external_collider_count = avatar->colliders.size() - avatar->colliders.external_begin;
+		interaction_collider_count += external_collider_count;
+		for (uint32_t chain_i = 0; chain_i < avatar->joints.chains.size(); chain_i++) {
+			const VRMSpringBoneChain &chain = avatar->joints.chains[chain_i];
+			if (chain.asleep) {
+				sleeping_chain_count++;
+				continue;
+			}
+			const uint64_t solved_joints = avatar->lod == VRMTopLevel::SPRING_BONE_LOD_ROOT_ONLY ? 1 : chain.joint_end - chain.joint_begin;
+			collision_pair_count += solved_joints * (chain.collider_end - chain.collider_begin) * avatar->frame_substeps;
+			collision_pair_count_unculled += solved_joints * (chain.spring_bone->collider_count + (chain.interacting ? external_collider_count : 0)) * avatar->frame_substeps;
+		}
+		frame_avatar_count++;
+		frame_joint_count += avatar->joints.size();
+		if (avatar->update_mode == VRMTopLevel::SPRING_BONE_UPDATE_ASYNC) {
+			async_step.avatars.push_back(avatar);
+			for (uint32_t chain_i = 0; chain_i < avatar->joints.chains.size(); chain_i++) {
+				StepChain step_chain;
+				step_chain.avatar = avatar;
+				step_chain.chain = chain_i;
+				async_step.chains.push_back(step_chain);
+			}
+			continue;
+		}
+		step_avatars.push_back(avatar);
+		if (avatar->update_mode == VRMTopLevel::SPRING_BONE_UPDATE_PARALLEL && avatar->joints.size() >= uint32_t(avatar->parallel_min_joints)) {
+			for (uint32_t chain_i = 0; chain_i < avatar->joints.chains.size(); chain_i++) {
+				StepChain step_chain;
+				step_chain.avatar = avatar;
+				step_chain.chain = chain_i;
+				step_chains.push_back(step_chain);
+			}
+		} else {
+			const uint64_t begin_usec = OS::get_singleton()->get_ticks_usec();
+			for (uint32_t chain_i = 0; chain_i < avatar->joints.chains.size(); chain_i++) {
+				_solve_avatar_chain(avatar, chain_i);
+			}
+			integration_usec += OS::get_singleton()->get_ticks_usec() - begin_usec;
+		}
+	}
+
+	frame_buffer_growth_count = 0;
+	if (prepared_avatars.ptr() != prepared_avatars_storage) {
+		frame_buffer_growth_count++;
+	}
+	if (interaction_colliders.ptr() != interaction_colliders_storage) {
+		frame_buffer_growth_count++;
+	}
+	if (interaction_cells.ptr() != interaction_cells_storage) {
+		frame_buffer_growth_count++;
+	}
+	if (interaction_large_colliders.ptr() != interaction_large_colliders_storage) {
+		frame_buffer_growth_count++;
+	}
+	if (step_avatars.ptr() != step_avatars_storage) {
+		frame_buffer_growth_count++;
+	}
+	if (step_chains.ptr() != step_chains_storage) {
+		frame_buffer_growth_count++;
+	}
+	if (async_step.avatars.ptr() != async_avatars_storage) {
+		frame_buffer_growth_count++;
+	}
+	if (async_step.chains.ptr() != async_chains_storage) {
+		frame_buffer_growth_count++;
+	}
+	// The async solves only write joints, so the avatar buffers are final.
+	for (uint32_t avatar_i = 0; avatar_i < prepared_avatars.size(); avatar_i++) {
+		Avatar *avatar = prepared_avatars[avatar_i];
+		const uint32_t storage_hash = _get_avatar_storage_hash(avatar);
+		if (storage_hash != avatar->storage_hash) {
+			avatar->storage_hash = storage_hash;
+			frame_buffer_growth_count++;
+		}
+	}
+
+	// Nothing touches the async avatars again until the next step or sync()
+	// waits for them, so their solve overlaps the rest of the frame.
+	if (async_step.chains.size()) {
+		async_step.group = WorkerThreadPool::get_singleton()->add_native_group_task(&VRMSpringBoneServer::_solve_chain, async_step.chains.ptr(), async_step.chains.size(), -1, true);
+		async_step.pending = true;
+	}
+
+	// Chains only depend on their own joints, so the chains of every parallel
+	// avatar go into one group task. The native task avoids allocating a
+	// template callback per frame.
+	uint64_t begin_usec = OS::get_singleton()->get_ticks_usec();
+	if (step_chains.size() > 1) {
+		WorkerThreadPool::GroupID group_id = WorkerThreadPool::get_singleton()->add_native_group_task(&VRMSpringBoneServer::_solve_chain, step_chains.ptr(), step_chains.size(), -1, true);
+		WorkerThreadPool::get_singleton()->wait_for_group_task_completion(group_id);
+	} else if (step_chains.size() == 1) {
+		_solve_chain(step_chains.ptr(), 0);
+	}
+	integration_usec += OS::get_singleton()->get_ticks_usec() - begin_usec;
+
+	// Poses are written back serially in registration order, so the result
+	// does not depend on how the chains were scheduled. Spring bones sharing
+	// a skeleton stage their poses first and each skeleton is written once.
+	begin_usec = OS::get_singleton()->get_ticks_usec();
+	for (uint32_t avatar_i = 0; avatar_i < step_avatars.size(); avatar_i++) {
+		_write_back(step_avatars[avatar_i]);
+	}
+	write_back_usec += OS::get_singleton()->get_ticks_usec() - begin_usec;
+
+#ifdef DEBUG_ENABLED
+	if (frame_buffer_growth_count && !setup_since_step) {
+		ERR_PRINT_ONCE(vformat("VRMSpringBoneServer step grew %d server or avatar buffers with no avatar changes since the previous step.", frame_buffer_growth_count));
+	}
+#endif
+	setup_since_step = false;
+}
+
+void VRMSpringBoneServer::_update_interaction_space(Avatar *p_avatar) {
+	// Composed from the local transforms so it also works out of the tree.
+	Transform3D space;
+	const Node *skeleton_parent = p_avatar->skeleton_poses.size() ? p_avatar->skeleton_poses[0].skeleton->get_parent() : nullptr;
+	for (const Node3D *node = Object::cast_to<Node3D>(skeleton_parent); node; node = node->get_parent_node_3d()) {
+		space = node->get_transform() * space;
+	}
+	p_avatar->interaction_space = space;
+	p_avatar->interaction_space_inv = space.affine_inverse();
+	const Vector3 scale = space.basis.get_scale_abs();
+	p_avatar->interaction_scale = MAX(scale.x, MAX(scale.y, scale.z));
+}
+
+Vector3i VRMSpringBoneServer::_interaction_cell(const Vector3 &p_point) const {
+	return Vector3i((p_point / interaction_cell_size).floor());
+}
+
+uint64_t VRMSpringBoneServer::_interaction_cell_key(int32_t p_x, int32_t p_y, int32_t p_z) {
+	// 21 bits per axis. Cells that wrap onto the same key only add candidates.
+	return (uint64_t(p_x & 0x1FFFFF) << 42) | (uint64_t(p_y & 0x1FFFFF) << 21) | uint64_t(p_z & 0x1FFFFF);
+}
+
+void VRMSpringBoneServer::_build_interaction_grid() {
+	interaction_colliders.clear();
+	interaction_cells.clear();
+	interaction_large_colliders.clear();
+	interaction_stamp = 0;
+	uint32_t interacting_avatars = 0;
+	for (uint32_t avatar_i = 0; avatar_i < prepared_avatars.size(); avatar_i++) {
+		interacting_avatars += prepared_avatars[avatar_i]->interaction && prepared_avatars[avatar_i]->trace_mode == TRACE_NONE;
+	}
+	if (interacting_avatars < 2) {
+		return;
+	}
+	for (uint32_t avatar_i = 0; avatar_i < prepared_avatars.size(); avatar_i++) {
+		const Avatar *avatar = prepared_avatars[avatar_i];
+		// Traces replay without other avatars, so they are left out.
+		if (!avatar->interaction || avatar->trace_mode != TRACE_NONE) {
+			continue;
+		}
+		const VRMColliderTable &table = avatar->colliders;
+		for (uint32_t collider_i = 0; collider_i < table.external_begin; collider_i++) {
+			// Planes are unbounded and belong to the avatar's own ground.
+			if (table.shapes[collider_i] == VRMColliderTable::SHAPE_PLANE) {
+				continue;
+			}
+			InteractionCollider collider;
+			collider.shape = VRMColliderTable::Shape(table.shapes[collider_i]);
+			collider.position = avatar->interaction_space.xform(table.positions.get(collider_i));
+			collider.tail = collider.shape == VRMColliderTable::SHAPE_CAPSULE ? avatar->interaction_space.xform(table.tails.get(collider_i)) : collider.position;
+			collider.radius = table.radii[collider_i] * avatar->interaction_scale;
+			collider.avatar = avatar;
+			const uint32_t index = interaction_colliders.size();
+			interaction_colliders.push_back(collider);
+			const Vector3 extent(collider.radius, collider.radius, collider.radius);
+			const Vector3 low(MIN(collider.position.x, collider.tail.x), MIN(collider.position.y, collider.tail.y), MIN(collider.position.z, collider.tail.z));
+			const Vector3 high(MAX(collider.position.x, collider.tail.x), MAX(collider.position.y, collider.tail.y), MAX(collider.position.z, collider.tail.z));
+			const Vector3i begin = _interaction_cell(low - extent);
+			const Vector3i end = _interaction_cell(high + extent);
+			const Vector3i cells = end - begin + Vector3i(1, 1, 1);
+			if (uint64_t(cells.x) * cells.y * cells.z > INTERACTION_MAX_CELLS) {
+				interaction_large_colliders.push_back(index);
+				continue;
+			}
+			for (int32_t x = begin.x; x <= end.x; x++) {
+				for (int32_t y = begin.y; y <= end.y; y++) {
+					for (int32_t z = begin.z; z <= end.z; z++) {
+						InteractionCell cell;
+						cell.key = _interaction_cell_key(x, y, z);
+						cell.collider = index;
+						interaction_cells.push_back(cell);
+					}
+				}
+			}
+		}
+	}
+	interaction_cells.sort();
+}
+
+void VRMSpringBoneServer::_add_interaction_collider(Avatar *p_avatar, VRMSpringBoneChain &r_chain, uint32_t p_collider, const Vector3 &p_center, real_t p_radius) {
+	InteractionCollider &collider = interaction_colliders[p_collider];
+	if (collider.avatar == p_avatar || !VRMColliderTable::shape_can_reach(collider.shape, collider.position, collider.tail, collider.radius, p_center, p_radius)) {
+		return;
+	}
+	r_chain.interacting = true;
+	if (collider.stamp == interaction_stamp) {
+		return;
+	}
+	collider.stamp = interaction_stamp;
+	const Vector3 position = p_avatar->interaction_space_inv.xform(collider.position);
+	const Vector3 tail = p_avatar->interaction_space_inv.xform(collider.tail);
+	p_avatar->colliders.add_collider(collider.shape, position, tail, collider.radius / p_avatar->interaction_scale);
+}
+
+void VRMSpringBoneServer::_gather_interaction_colliders(Avatar *p_avatar) {
+	p_avatar->colliders.clear_external();
+	for (uint32_t chain_i = 0; chain_i < p_avatar->joints.chains.size(); chain_i++) {
+		p_avatar->joints.chains[chain_i].interacting = false;
+	}
+	if (interaction_colliders.is_empty() || !p_avatar->interaction || p_avatar->trace_mode != TRACE_NONE) {
+		return;
+	}
+	interaction_stamp++;
+	for (uint32_t chain_i = 0; chain_i < p_avatar->joints.chains.size(); chain_i++) {
+		VRMSpringBoneChain &chain = p_avatar->joints.chains[chain_i];
+		const Vector3 center = p_avatar->interaction_space.xform(chain.bound_center);
+		const real_t radius = chain.bound_radius * p_avatar->interaction_scale;
+		const Vector3 extent(radius, radius, radius);
+		const Vector3i begin = _interaction_cell(center - extent);
+		const Vector3i end = _interaction_cell(center + extent);
+		const Vector3i cells = end - begin + Vector3i(1, 1, 1);
+		if (uint64_t(cells.x) * cells.y * cells.z > INTERACTION_MAX_CELLS) {
+			// Covers more cells than there are worth looking up.
+			for (uint32_t collider_i = 0; collider_i < interaction_colliders.size(); collider_i++) {
+				_add_interaction_collider(p_avatar, chain, collider_i, center, radius);
+			}
+			continue;
+		}
+		for (int32_t x = begin.x; x <= end.x; x++) {
+			for (int32_t y = begin.y; y <= end.y; y++) {
+				for (int32_t z = begin.z; z <= end.z; z++) {
+					const uint64_t key = _interaction_cell_key(x, y, z);
+					// Lower bound of the key in the sorted cells.
+					uint32_t low = 0;
+					uint32_t high = interaction_cells.size();
+					while (low < high) {
+						const uint32_t middle = (low + high) / 2;
+						if (interaction_cells[middle].key < key) {
+							low = middle + 1;
+						} else {
+							high = middle;
+						}
+					}
+					for (uint32_t cell_i = low; cell_i < interaction_cells.size() && interaction_cells[cell_i].key == key; cell_i++) {
+						_add_interaction_collider(p_avatar, chain, interaction_cells[cell_i].collider, center, radius);
+					}
+				}
+			}
+		}
+		for (uint32_t large_i = 0; large_i < interaction_large_colliders.size(); large_i++) {
+			_add_interaction_collider(p_avatar, chain, interaction_large_colliders[large_i], center, radius);
+		}
+	}
+}
+
+void VRMSpringBoneServer::_write_back(Avatar *p_avatar) {
+	for (const Ref<VRMSpringBone> &spring_bone : p_avatar->spring_bones) {
+		if (spring_bone->joint_count) {
+			spring_bone->apply(p_avatar->joints, p_avatar->skeleton_poses[spring_bone->skeleton_pose], p_avatar->lod_blend, p_avatar->lod == VRMTopLevel::SPRING_BONE_LOD_ROOT_ONLY);
+		}
+	}
+	for (uint32_t pose_i = 0; pose_i < p_avatar->skeleton_poses.size(); pose_i++) {
+		p_avatar->skeleton_poses[pose_i].commit();
+	}
+	_store_written_tails(p_avatar);
+	if (p_avatar->trace_output.is_valid()) {
+		const VRMSpringBoneJoints &joints = p_avatar->joints;
+		for (uint32_t joint_i = 0; joint_i < joints.size(); joint_i++) {
+			p_avatar->trace_output->store_real(joints.current_tail.x[joint_i]);
+			p_avatar->trace_output->store_real(joints.current_tail.y[joint_i]);
+			p_avatar->trace_output->store_real(joints.current_tail.z[joint_i]);
+		}
+	}
+}
+
+void VRMSpringBoneServer::_store_written_tails(Avatar *p_avatar) {
+	const VRMSpringBoneJoints &joints = p_avatar->joints;
+	p_avatar->written_tails.resize(joints.size());
+	for (const Ref<VRMSpringBone> &spring_bone : p_avatar->spring_bones) {
+		const uint32_t joint_end = spring_bone->joint_offset + spring_bone->joint_count;
+		if (spring_bone->frame_has_center) {
+			p_avatar->written_tails.set_xformed(joints.current_tail, spring_bone->frame_center, spring_bone->joint_offset, joint_end);
+			continue;
+		}
+		for (uint32_t joint_i = spring_bone->joint_offset; joint_i < joint_end; joint_i++) {
+			p_avatar->written_tails.set(joint_i, joints.current_tail.get(joint_i));
+		}
+	}
+}
+
+void VRMSpringBoneServer::_finish_async_step(AsyncStep &r_async_step, bool p_write_back) {
+	if (!r_async_step.pending) {
+		return;
+	}
+	r_async_step.pending = false;
+	uint64_t begin_usec = OS::get_singleton()->get_ticks_usec();
+	WorkerThreadPool::get_singleton()->wait_for_group_task_completion(r_async_step.group);
+	integration_usec += OS::get_singleton()->get_ticks_usec() - begin_usec;
+	if (!p_write_back) {
+		return;
+	}
+	begin_usec = OS::get_singleton()->get_ticks_usec();
+	for (uint32_t avatar_i = 0; avatar_i < r_async_step.avatars.size(); avatar_i++) {
+		_write_back(r_async_step.avatars[avatar_i]);
+	}
+	write_back_usec += OS::get_singleton()->get_ticks_usec() - begin_usec;
+}
+
+void VRMSpringBoneServer::sync() {
+	_finish_async_step(async_steps[false], true);
+	_finish_async_step(async_steps[true], true);
+}
+
+int VRMSpringBoneServer::get_frame_buffer_growth_count() const {
+	return frame_buffer_growth_count;
+}
+
+int VRMSpringBoneServer::get_pose_query_count() const {
+	return pose_query_count;
+}
+
+int VRMSpringBoneServer::get_broadphase_test_count() const {
+	return broadphase_test_count;
 }
 
-void VRMTopLevel::set_update_secondary_fixed(bool p_fixed) {
-	update_secondary_fixed = p_fixed;
+int64_t VRMSpringBoneServer::get_collision_pair_count() const {
+	return collision_pair_count;
 }
 
-bool VRMTopLevel::get_update_in_editor() {
-	return update_in_editor;
+int64_t VRMSpringBoneServer::get_collision_pair_count_unculled() const {
+	return collision_pair_count_unculled;
 }
 
-void VRMTopLevel::set_update_in_editor(bool p_update) {
-	update_in_editor = p_update;
+int VRMSpringBoneServer::get_sleeping_chain_count() const {
+	return sleeping_chain_count;
 }
 
-bool VRMTopLevel::get_gizmo_spring_bone() {
-	return gizmo_spring_bone;
+int VRMSpringBoneServer::get_interaction_collider_count() const {
+	return interaction_collider_count;
 }
 
-void VRMTopLevel::set_gizmo_spring_bone(bool p_update) {
-	gizmo_spring_bone = p_update;
+void VRMSpringBoneServer::set_interaction_cell_size(real_t p_size) {
+	ERR_FAIL_COND(p_size <= 0);
+	interaction_cell_size = p_size;
 }
 
-Color VRMTopLevel::get_gizmo_spring_bone_color() {
-	return gizmo_spring_bone_color;
+real_t VRMSpringBoneServer::get_interaction_cell_size() const {
+	return interaction_cell_size;
 }
 
-void VRMTopLevel::_bind_methods() {
-	ClassDB::bind_method(D_METHOD("get_vrm_skeleton"), &VRMTopLevel::get_vrm_skeleton);
-	ClassDB::bind_method(D_METHOD("set_vrm_skeleton"), &VRMTopLevel::set_vrm_skeleton);
-	ClassDB::bind_method(D_METHOD("get_vrm_animplayer"), &VRMTopLevel::get_vrm_animplayer);
-	ClassDB::bind_method(D_METHOD("set_vrm_animplayer"), &VRMTopLevel::set_vrm_animplayer);
-	ClassDB::bind_method(D_METHOD("get_vrm_secondary"), &VRMTopLevel::get_vrm_secondary);
-	ClassDB::bind_method(D_METHOD("set_vrm_secondary"), &VRMTopLevel::set_vrm_secondary);
-	ClassDB::bind_method(D_METHOD("get_vrm_meta"), &VRMTopLevel::get_vrm_meta);
-	ClassDB::bind_method(D_METHOD("set_vrm_meta"), &VRMTopLevel::set_vrm_meta);
-	ClassDB::bind_method(D_METHOD("get_update_secondary_fixed"), &VRMTopLevel::get_update_secondary_fixed);
-	ClassDB::bind_method(D_METHOD("set_update_secondary_fixed"), &VRMTopLevel::set_update_secondary_fixed);
-	ClassDB::bind_method(D_METHOD("get_update_in_editor"), &VRMTopLevel::get_update_in_editor);
-	ClassDB::bind_method(D_METHOD("set_update_in_editor"), &VRMTopLevel::set_update_in_editor);
-	ClassDB::bind_method(D_METHOD("get_gizmo_spring_bone_color"), &VRMTopLevel::get_gizmo_spring_bone_color);
-	ClassDB::bind_method(D_METHOD("set_gizmo_spring_bone_color"), &VRMTopLevel::set_gizmo_spring_bone_color);
+double VRMSpringBoneServer::get_monitor(Monitor p_monitor) const {
+	switch (p_monitor) {
+		case MONITOR_AVATARS:
+			return frame_avatar_count;
+		case MONITOR_JOINTS:
+			return frame_joint_count;
+		case MONITOR_COLLIDERS:
+			return frame_collider_count;
+		case MONITOR_COLLISION_PAIRS:
+			return collision_pair_count;
+		case MONITOR_COLLIDER_UPDATE_USEC:
+			return collider_update_usec;
+		case MONITOR_INTEGRATION_USEC:
+			return integration_usec;
+		case MONITOR_WRITE_BACK_USEC:
+			return write_back_usec;
+		case MONITOR_GIZMO_DRAW_USEC:
+			return gizmo_draw_usec;
+		case MONITOR_SLEEPING_CHAINS:
+			return sleeping_chain_count;
+		case MONITOR_INTERACTION_COLLIDERS:
+			return interaction_collider_count;
+		default:
+			break;
+	}
+	ERR_FAIL_V_MSG(0, "Invalid VRMSpringBoneServer monitor.");
+}
 
-	ADD_PROPERTY(PropertyInfo(Variant::NODE_PATH, "vrm_skeleton"), "set_vrm_skeleton", "get_vrm_skeleton");
-	ADD_PROPERTY(PropertyInfo(Variant::NODE_PATH, "vrm_animplayer"), "set_vrm_animplayer", "get_vrm_animplayer");
-	ADD_PROPERTY(PropertyInfo(Variant::NODE_PATH, "vrm_secondary"), "set_vrm_secondary", "get_vrm_secondary");
-	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "vrm_meta", PROPERTY_HINT_RESOURCE_TYPE, "VRMMeta"), "set_vrm_meta", "get_vrm_meta");
-	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "update_secondary_fixed"), "set_update_secondary_fixed", "get_update_secondary_fixed");
-	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "update_in_editor"), "set_update_in_editor", "get_update_in_editor");
-	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "gizmo_spring_bone"), "set_gizmo_spring_bone", "get_gizmo_spring_bone");
-	ADD_PROPERTY(PropertyInfo(Variant::COLOR, "gizmo_spring_bone_color"), "set_gizmo_spring_bone_color", "get_gizmo_spring_bone_color");
+void VRMSpringBoneServer::add_gizmo_draw_time(uint64_t p_usec) {
+	gizmo_draw_usec += p_usec;
 }
 
-void VRMTopLevel::set_gizmo_spring_bone_color(Color p_color) {
-	gizmo_spring_bone_color = p_color;
+static const char *vrm_spring_bone_monitor_ids[VRMSpringBoneServer::MONITOR_MAX] = {
+	"VRM/avatars",
+	"VRM/joints",
+	"VRM/colliders",
+	"VRM/collision_pair_tests",
+	"VRM/collider_update_usec",
+	"VRM/integration_usec",
+	"VRM/write_back_usec",
+	"VRM/gizmo_draw_usec",
+	"VRM/sleeping_chains",
+	"VRM/interaction_colliders",
+};
+
+void VRMSpringBoneServer::register_monitors() {
+	Performance *performance = Performance::get_singleton();
+	ERR_FAIL_NULL(performance);
+	monitors_registered = true;
+	for (int monitor_i = 0; monitor_i < MONITOR_MAX; monitor_i++) {
+		Vector<Variant> args;
+		args.push_back(monitor_i);
+		performance->add_custom_monitor(vrm_spring_bone_monitor_ids[monitor_i], callable_mp(this, &VRMSpringBoneServer::get_monitor), args);
+	}
 }
 
-Quaternion VRMTopLevel::from_to_rotation(Vector3 from, Vector3 to) {
-	Vector3 axis = from.cross(to);
-	if (Math::is_equal_approx(axis.x, real_t(0.0)) && Math::is_equal_approx(axis.y, real_t(0.0)) && Math::is_equal_approx(axis.z, real_t(0.0))) {
-		return Quaternion();
+void VRMSpringBoneServer::unregister_monitors() {
+	Performance *performance = Performance::get_singleton();
+	if (!monitors_registered || !performance) {
+		return;
 	}
-	real_t angle = from.angle_to(to);
-	if (Math::is_equal_approx(angle, real_t(0.0))) {
-		angle = 0.0;
+	monitors_registered = false;
+	for (int monitor_i = 0; monitor_i < MONITOR_MAX; monitor_i++) {
+		if (performance->has_custom_monitor(vrm_spring_bone_monitor_ids[monitor_i])) {
+			performance->remove_custom_monitor(vrm_spring_bone_monitor_ids[monitor_i]);
+		}
 	}
-	return Quaternion(axis.normalized(), angle);
 }
 
-Vector3 VRMTopLevel::transform_point(Transform3D transform, Vector3 point) {
-	Vector3 sc = transform.basis.get_scale();
-	return transform.basis.get_rotation_quaternion().xform(Vector3(point.x * sc.x, point.y * sc.y, point.z * sc.z)) + transform.origin;
-}
-Vector3 VRMTopLevel::inv_transform_point(Transform3D transform, Vector3 point) {
-	Vector3 diff = point - transform.origin;
-	Vector3 sc = transform.basis.get_scale();
-	return transform.basis.get_rotation_quaternion().inverse().xform(Vector3(diff.x / sc.x, diff.y / sc.y, diff.z / sc.z));
+void VRMSpringBoneServer::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("avatar_create"), &VRMSpringBoneServer::avatar_create);
+	ClassDB::bind_method(D_METHOD("avatar_free", "avatar"), &VRMSpringBoneServer::avatar_free);
+	ClassDB::bind_method(D_METHOD("avatar_set_active", "avatar", "active"), &VRMSpringBoneServer::avatar_set_active);
+	ClassDB::bind_method(D_METHOD("avatar_is_active", "avatar"), &VRMSpringBoneServer::avatar_is_active);
+	ClassDB::bind_method(D_METHOD("avatar_set_fixed_step", "avatar", "step_rate", "max_substeps"), &VRMSpringBoneServer::avatar_set_fixed_step);
+	ClassDB::bind_method(D_METHOD("avatar_set_lod", "avatar", "lod"), &VRMSpringBoneServer::avatar_set_lod);
+	ClassDB::bind_method(D_METHOD("avatar_get_lod", "avatar"), &VRMSpringBoneServer::avatar_get_lod);
+	ClassDB::bind_method(D_METHOD("avatar_set_lod_blend_time", "avatar", "blend_time"), &VRMSpringBoneServer::avatar_set_lod_blend_time);
+	ClassDB::bind_method(D_METHOD("avatar_set_sleep", "avatar", "frames", "threshold"), &VRMSpringBoneServer::avatar_set_sleep);
+	ClassDB::bind_method(D_METHOD("avatar_set_interaction", "avatar", "interaction"), &VRMSpringBoneServer::avatar_set_interaction);
+	ClassDB::bind_method(D_METHOD("avatar_wake", "avatar"), &VRMSpringBoneServer::avatar_wake);
+	ClassDB::bind_method(D_METHOD("avatar_trace_record", "avatar", "path"), &VRMSpringBoneServer::avatar_trace_record);
+	ClassDB::bind_method(D_METHOD("avatar_trace_replay", "avatar", "path", "output_path"), &VRMSpringBoneServer::avatar_trace_replay, DEFVAL(String()));
+	ClassDB::bind_method(D_METHOD("avatar_trace_stop", "avatar"), &VRMSpringBoneServer::avatar_trace_stop);
+	ClassDB::bind_method(D_METHOD("avatar_get_trace_mode", "avatar"), &VRMSpringBoneServer::avatar_get_trace_mode);
+	ClassDB::bind_method(D_METHOD("avatar_get_spring_bone_count", "avatar"), &VRMSpringBoneServer::avatar_get_spring_bone_count);
+	ClassDB::bind_method(D_METHOD("avatar_set_spring_bone_param", "avatar", "spring_bone", "param", "value"), &VRMSpringBoneServer::avatar_set_spring_bone_param);
+	ClassDB::bind_method(D_METHOD("avatar_get_spring_bone_param", "avatar", "spring_bone", "param"), &VRMSpringBoneServer::avatar_get_spring_bone_param);
+	ClassDB::bind_method(D_METHOD("avatar_set_spring_bone_gravity_dir", "avatar", "spring_bone", "gravity_dir"), &VRMSpringBoneServer::avatar_set_spring_bone_gravity_dir);
+	ClassDB::bind_method(D_METHOD("avatar_get_spring_bone_gravity_dir", "avatar", "spring_bone"), &VRMSpringBoneServer::avatar_get_spring_bone_gravity_dir);
+	ClassDB::bind_method(D_METHOD("sync"), &VRMSpringBoneServer::sync);
+	ClassDB::bind_method(D_METHOD("get_pose_query_count"), &VRMSpringBoneServer::get_pose_query_count);
+	ClassDB::bind_method(D_METHOD("get_frame_buffer_growth_count"), &VRMSpringBoneServer::get_frame_buffer_growth_count);
+	ClassDB::bind_method(D_METHOD("get_broadphase_test_count"), &VRMSpringBoneServer::get_broadphase_test_count);
+	ClassDB::bind_method(D_METHOD("get_collision_pair_count"), &VRMSpringBoneServer::get_collision_pair_count);
+	ClassDB::bind_method(D_METHOD("get_collision_pair_count_unculled"), &VRMSpringBoneServer::get_collision_pair_count_unculled);
+	ClassDB::bind_method(D_METHOD("get_sleeping_chain_count"), &VRMSpringBoneServer::get_sleeping_chain_count);
+	ClassDB::bind_method(D_METHOD("get_interaction_collider_count"), &VRMSpringBoneServer::get_interaction_collider_count);
+	ClassDB::bind_method(D_METHOD("set_interaction_cell_size", "size"), &VRMSpringBoneServer::set_interaction_cell_size);
+	ClassDB::bind_method(D_METHOD("get_interaction_cell_size"), &VRMSpringBoneServer::get_interaction_cell_size);
+	ClassDB::bind_method(D_METHOD("get_monitor", "monitor"), &VRMSpringBoneServer::get_monitor);
+
+	BIND_ENUM_CONSTANT(SPRING_BONE_PARAM_STIFFNESS);
+	BIND_ENUM_CONSTANT(SPRING_BONE_PARAM_GRAVITY_POWER);
+	BIND_ENUM_CONSTANT(SPRING_BONE_PARAM_DRAG);
+	BIND_ENUM_CONSTANT(SPRING_BONE_PARAM_HIT_RADIUS);
+
+	BIND_ENUM_CONSTANT(TRACE_NONE);
+	BIND_ENUM_CONSTANT(TRACE_RECORD);
+	BIND_ENUM_CONSTANT(TRACE_REPLAY);
+
+	BIND_ENUM_CONSTANT(MONITOR_AVATARS);
+	BIND_ENUM_CONSTANT(MONITOR_JOINTS);
+	BIND_ENUM_CONSTANT(MONITOR_COLLIDERS);
+	BIND_ENUM_CONSTANT(MONITOR_COLLISION_PAIRS);
+	BIND_ENUM_CONSTANT(MONITOR_COLLIDER_UPDATE_USEC);
+	BIND_ENUM_CONSTANT(MONITOR_INTEGRATION_USEC);
+	BIND_ENUM_CONSTANT(MONITOR_WRITE_BACK_USEC);
+	BIND_ENUM_CONSTANT(MONITOR_GIZMO_DRAW_USEC);
+	BIND_ENUM_CONSTANT(MONITOR_SLEEPING_CHAINS);
+	BIND_ENUM_CONSTANT(MONITOR_INTERACTION_COLLIDERS);
+	BIND_ENUM_CONSTANT(MONITOR_MAX);
 }
-void SphereCollider::_ready(int bone_idx, Vector3 collider_offset, float collider_radius) {
-	// TODO: Do not shadow notification().
-	idx = bone_idx;
-	offset = collider_offset;
-	radius = collider_radius;
+
+VRMSpringBoneServer::VRMSpringBoneServer() {
+	singleton = this;
 }
-void SphereCollider::update(Node3D *parent, Skeleton3D *skel) {
-	if (parent->get_class() == "Skeleton3D" && idx != -1) {
-		Skeleton3D *skeleton = cast_to<Skeleton3D>(parent);
-		position = VRMTopLevel::transform_point(skeleton->get_relative_transform(skeleton->get_parent()) * skel->get_bone_global_pose(idx), offset);
-	} else {
-		position = VRMTopLevel::transform_point(parent->get_relative_transform(parent->get_parent()), offset);
+
+VRMSpringBoneServer::~VRMSpringBoneServer() {
+	// The scene is gone by now, only wait for the workers.
+	_finish_async_step(async_steps[false], false);
+	_finish_async_step(async_steps[true], false);
+	for (uint32_t avatar_i = 0; avatar_i < avatars.size(); avatar_i++) {
+		memdelete(avatars[avatar_i]);
 	}
+	avatars.clear();
+	singleton = nullptr;
 }
-float SphereCollider::get_radius() {
-	return radius;
+
+void VRMSpringBoneBenchmark::_build_avatar(Node3D *p_root, int p_chain_count, int p_chain_depth, int p_collider_count, bool p_center, Vector<Ref<VRMSpringBone>> &r_spring_bones, Vector<Ref<VRMColliderGroup>> &r_collider_groups) {
+	Skeleton3D *skeleton = memnew(Skeleton3D);
+	skeleton->set_name("Skeleton");
+	p_root->add_child(skeleton);
+	Node *owner = memnew(Node);
+	owner->set_name("Secondary");
+	p_root->add_child(owner);
+
+	// Chains hang in a ring around the root bone, like hair around a head.
+	skeleton->add_bone("root");
+	Ref<VRMSpringBone> spring_bone;
+	spring_bone.instantiate();
+	spring_bone->skeleton = NodePath("../Skeleton");
+	if (p_center) {
+		spring_bone->center_bone = "root";
+	}
+	for (int chain_i = 0; chain_i < p_chain_count; chain_i++) {
+		const real_t angle = Math_TAU * chain_i / p_chain_count;
+		int parent = 0;
+		for (int depth_i = 0; depth_i < p_chain_depth; depth_i++) {
+			const String bone_name = vformat("chain_%d_%d", chain_i, depth_i);
+			const int bone = skeleton->get_bone_count();
+			skeleton->add_bone(bone_name);
+			skeleton->set_bone_parent(bone, parent);
+			const Vector3 origin = depth_i == 0 ? Vector3(Math::cos(angle) * 0.1, 0.1, Math::sin(angle) * 0.1) : Vector3(0, -0.05, 0);
+			skeleton->set_bone_rest(bone, Transform3D(Basis(), origin));
+			parent = bone;
+			if (depth_i == 0) {
+				spring_bone->root_bones.push_back(bone_name);
+			}
+		}
+	}
+	skeleton->reset_bone_poses();
+
+	Ref<VRMColliderGroup> collider_group;
+	collider_group.instantiate();
+	collider_group->skeleton_or_node = NodePath("../Skeleton");
+	collider_group->bone = "root";
+	for (int collider_i = 0; collider_i < p_collider_count; collider_i++) {
+		const real_t angle = Math_TAU * collider_i / p_collider_count;
+		const real_t height = -0.4 * collider_i / p_collider_count;
+		collider_group->sphere_colliders.push_back(Vector4(Math::cos(angle) * 0.12, height, Math::sin(angle) * 0.12, 0.03));
+	}
+	spring_bone->collider_groups.push_back(collider_group);
+	r_spring_bones.push_back(spring_bone);
+	r_collider_groups.push_back(collider_group);
 }
-Vector3 SphereCollider::get_position() {
-	return position;
+
+Dictionary VRMSpringBoneBenchmark::run(const Dictionary &p_params) {
+	VRMSpringBoneServer *server = VRMSpringBoneServer::get_singleton();
+	ERR_FAIL_NULL_V(server, Dictionary());
+	const int avatar_count = MAX(int(p_params.get("avatars", 8)), 1);
+	const int chain_count = MAX(int(p_params.get("chains", 16)), 1);
+	const int chain_depth = MAX(int(p_params.get("chain_depth", 8)), 1);
+	const int collider_count = MAX(int(p_params.get("colliders", 32)), 0);
+	const int frame_count = MAX(int(p_params.get("frames", 600)), 1);
+	const int warmup_frames = MAX(int(p_params.get("warmup_frames", 60)), 0);
+	const VRMTopLevel::SpringBoneUpdateMode update_mode = VRMTopLevel::SpringBoneUpdateMode(int(p_params.get("update_mode", VRMTopLevel::SPRING_BONE_UPDATE_SERIAL)));
+	const int parallel_min_joints = MAX(int(p_params.get("parallel_min_joints", 0)), 0);
+	const int fixed_step_rate = MAX(int(p_params.get("fixed_step_rate", 0)), 0);
+	const int sleep_frames = MAX(int(p_params.get("sleep_frames", 0)), 0);
+	// Percentage of avatars that stand still, to measure sleeping.
+	const int idle_percent = CLAMP(int(p_params.get("idle_percent", 0)), 0, 100);
+	const bool center = p_params.get("center", false);
+	const bool interaction = p_params.get("interaction", false);
+	// Distance between neighbouring avatars, close enough to touch by default.
+	const real_t spacing = p_params.get("spacing", 1.0);
+	const double delta = 1.0 / 60.0;
+
+	LocalVector<Node3D *> roots;
+	LocalVector<RID> avatars;
+	uint64_t joint_count = 0;
+	for (int avatar_i = 0; avatar_i < avatar_count; avatar_i++) {
+		Node3D *root = memnew(Node3D);
+		root->set_position(Vector3(avatar_i * spacing, 0, 0));
+		Vector<Ref<VRMSpringBone>> spring_bones;
+		Vector<Ref<VRMColliderGroup>> collider_groups;
+		_build_avatar(root, chain_count, chain_depth, collider_count, center, spring_bones, collider_groups);
+		RID avatar = server->avatar_create();
+		server->avatar_setup(avatar, root->get_node(NodePath("Secondary")), spring_bones, collider_groups);
+		server->avatar_set_active(avatar, true);
+		server->avatar_set_physics_process(avatar, false);
+		server->avatar_set_update_mode(avatar, update_mode, parallel_min_joints);
+		server->avatar_set_fixed_step(avatar, fixed_step_rate, 4);
+		server->avatar_set_sleep(avatar, sleep_frames, 0.0005);
+		server->avatar_set_interaction(avatar, interaction);
+		joint_count += server->avatar_get(avatar)->joints.size();
+		roots.push_back(root);
+		avatars.push_back(avatar);
+	}
+
+	Vector<uint64_t> frame_usecs;
+	uint64_t total_usec = 0;
+	uint64_t collision_pairs = 0;
+	uint64_t collision_pairs_unculled = 0;
+	uint64_t sleeping_chains = 0;
+	uint64_t interaction_colliders = 0;
+	for (int frame_i = -warmup_frames; frame_i < frame_count; frame_i++) {
+		// Sway the root bones so the chains have something to follow. The
+		// first idle_percent of the avatars stand still.
+		const real_t time = (frame_i + warmup_frames) * delta;
+		for (uint32_t root_i = uint32_t(roots.size() * idle_percent / 100); root_i < roots.size(); root_i++) {
+			Skeleton3D *skeleton = Object::cast_to<Skeleton3D>(roots[root_i]->get_node(NodePath("Skeleton")));
+			skeleton->set_bone_pose_rotation(0, Quaternion(Vector3(0, 1, 0), Math::sin(time * 2.0 + root_i) * 0.5));
+			skeleton->set_bone_pose_position(0, Vector3(Math::sin(time * 1.3 + root_i) * 0.1, 0, 0));
+		}
+		const uint64_t begin_usec = OS::get_singleton()->get_ticks_usec();
+		server->_step(delta, false);
+		const uint64_t frame_usec = OS::get_singleton()->get_ticks_usec() - begin_usec;
+		if (frame_i < 0) {
+			continue;
+		}
+		frame_usecs.push_back(frame_usec);
+		total_usec += frame_usec;
+		collision_pairs += server->get_collision_pair_count();
+		collision_pairs_unculled += server->get_collision_pair_count_unculled();
+		sleeping_chains += server->get_sleeping_chain_count();
+		interaction_colliders += server->get_interaction_collider_count();
+	}
+
+	for (uint32_t avatar_i = 0; avatar_i < avatars.size(); avatar_i++) {
+		server->avatar_free(avatars[avatar_i]);
+		memdelete(roots[avatar_i]);
+	}
+
+	frame_usecs.sort();
+	Dictionary params;
+	params["avatars"] = avatar_count;
+	params["chains"] = chain_count;
+	params["chain_depth"] = chain_depth;
+	params["colliders"] = collider_count;
+	params["frames"] = frame_count;
+	params["warmup_frames"] = warmup_frames;
+	params["update_mode"] = update_mode;
+	params["parallel_min_joints"] = parallel_min_joints;
+	params["fixed_step_rate"] = fixed_step_rate;
+	params["sleep_frames"] = sleep_frames;
+	params["idle_percent"] = idle_percent;
+	params["center"] = center;
+	params["interaction"] = interaction;
+	params["spacing"] = spacing;
+	Dictionary result;
+	result["params"] = params;
+	result["joints"] = joint_count;
+	result["collision_pairs_per_frame"] = double(collision_pairs) / frame_count;
+	result["collision_pairs_unculled_per_frame"] = double(collision_pairs_unculled) / frame_count;
+	result["sleeping_chains_per_frame"] = double(sleeping_chains) / frame_count;
+	result["interaction_colliders_per_frame"] = double(interaction_colliders) / frame_count;
+	result["ns_per_joint"] = joint_count ? total_usec * 1000.0 / (double(joint_count) * frame_count) : 0.0;
+	result["ns_per_collider_pair"] = collision_pairs ? total_usec * 1000.0 / double(collision_pairs) : 0.0;
+	result["frame_usec_mean"] = double(total_usec) / frame_count;
+	result["frame_usec_p50"] = frame_usecs[frame_usecs.size() / 2];
+	result["frame_usec_p99"] = frame_usecs[MIN(frame_usecs.size() - 1, frame_usecs.size() * 99 / 100)];
+	result["frame_usec_max"] = frame_usecs[frame_usecs.size() - 1];
+	return result;
 }
-Transform3D VRMSpringBoneLogic::get_transform(Skeleton3D *skel) {
-	return skel->get_relative_transform(skel->get_parent()) * skel->get_bone_global_pose_no_override(bone_idx);
+
+String VRMSpringBoneBenchmark::run_json(const Dictionary &p_params) {
+	return JSON::stringify(run(p_params), "\t");
 }
-Quaternion VRMSpringBoneLogic::get_rotation(Skeleton3D *skel) {
-	return get_transform(skel).basis.get_rotation_quaternion();
+
+void VRMSpringBoneBenchmark::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("run", "params"), &VRMSpringBoneBenchmark::run, DEFVAL(Dictionary()));
+	ClassDB::bind_method(D_METHOD("run_json", "params"), &VRMSpringBoneBenchmark::run_json, DEFVAL(Dictionary()));
 }
-Transform3D VRMSpringBoneLogic::get_local_transform(Skeleton3D *skel) {
-	return skel->get_bone_global_pose_no_override(bone_idx);
+
+SecondaryGizmo::SecondaryGizmo(Node *p_parent) {
+	set_mesh(memnew(ArrayMesh));
+	secondary_node = cast_to<VRMSecondary>(p_parent);
+	m->set_depth_draw_mode(StandardMaterial3D::DEPTH_DRAW_DISABLED);
+	m->set_shading_mode(BaseMaterial3D::SHADING_MODE_UNSHADED);
+	m->set_flag(BaseMaterial3D::FLAG_ALBEDO_FROM_VERTEX_COLOR, true);
+	m->set_transparency(BaseMaterial3D::TRANSPARENCY_ALPHA);
+	// Instance colors reach the material as vertex colors.
+	sphere_multimesh.instantiate();
+	sphere_multimesh->set_transform_format(MultiMesh::TRANSFORM_3D);
+	sphere_multimesh->set_use_colors(true);
+	sphere_multimesh->set_mesh(_create_unit_sphere());
+	sphere_instances = memnew(MultiMeshInstance3D);
+	sphere_instances->set_multimesh(sphere_multimesh);
+	sphere_instances->set_material_override(m);
+	add_child(sphere_instances, false, INTERNAL_MODE_FRONT);
 }
-Quaternion VRMSpringBoneLogic::get_local_rotation(Skeleton3D *skel) {
-	return get_local_transform(skel).basis.get_rotation_quaternion();
+Ref<ArrayMesh> SecondaryGizmo::_create_unit_sphere() {
+	// Three great circles, as line segments.
+	const int step = 16;
+	PackedVector3Array vertices;
+	vertices.resize(step * 3 * 2);
+	Vector3 *vertices_ptrw = vertices.ptrw();
+	for (int step_i = 0; step_i < step; step_i++) {
+		const real_t angle_a = Math_TAU * step_i / step;
+		const real_t angle_b = Math_TAU * (step_i + 1) / step;
+		const Vector2 a(Math::cos(angle_a), Math::sin(angle_a));
+		const Vector2 b(Math::cos(angle_b), Math::sin(angle_b));
+		vertices_ptrw[step_i * 6 + 0] = Vector3(0, a.x, a.y);
+		vertices_ptrw[step_i * 6 + 1] = Vector3(0, b.x, b.y);
+		vertices_ptrw[step_i * 6 + 2] = Vector3(a.x, 0, a.y);
+		vertices_ptrw[step_i * 6 + 3] = Vector3(b.x, 0, b.y);
+		vertices_ptrw[step_i * 6 + 4] = Vector3(a.x, a.y, 0);
+		vertices_ptrw[step_i * 6 + 5] = Vector3(b.x, b.y, 0);
+	}
+	Array arrays;
+	arrays.resize(Mesh::ARRAY_MAX);
+	arrays[Mesh::ARRAY_VERTEX] = vertices;
+	Ref<ArrayMesh> mesh;
+	mesh.instantiate();
+	mesh->add_surface_from_arrays(Mesh::PRIMITIVE_LINES, arrays);
+	return mesh;
 }
-void VRMSpringBoneLogic::reset(Skeleton3D *skel) {
-	skel->set_bone_global_pose_override(bone_idx, initial_transform, 1.0, true);
+void SecondaryGizmo::_add_camera_frustum(const Camera3D *p_camera) {
+	if (!p_camera) {
+		return;
+	}
+	const Vector<Plane> planes = p_camera->get_frustum();
+	ERR_FAIL_COND(planes.size() != 6);
+	const Transform3D global_transform = get_global_transform();
+	for (int32_t plane_i = 0; plane_i < planes.size(); plane_i++) {
+		frustum_planes.push_back(global_transform.xform_inv(planes[plane_i]));
+	}
 }
-void VRMSpringBoneLogic::setup(Skeleton3D *skel, int idx, Variant center, Vector3 local_child_position, Transform3D default_pose) {
-	initial_transform = default_pose;
-	bone_idx = idx;
-	Vector3 world_child_position = VRMTopLevel::transform_point(get_transform(skel), local_child_position);
-	if (Variant(center).get_type() != Variant::Type::NIL) {
-		current_tail = VRMTopLevel::inv_transform_point(center, world_child_position);
-	} else {
-		current_tail = world_child_position;
-	}
-	prev_tail = current_tail;
-	bone_axis = local_child_position.normalized();
-	length = local_child_position.length();
-}
-void VRMSpringBoneLogic::update(Skeleton3D *skel, Variant center, float stiffness_force, float drag_force, Vector3 external, Vector<Ref<SphereCollider>> colliders) {
-	Vector3 tmp_current_tail;
-	Vector3 tmp_prev_tail;
-	if (Variant(center).get_type() != Variant::Type::NIL) {
-		tmp_current_tail = VRMTopLevel::transform_point(center, current_tail);
-		tmp_prev_tail = VRMTopLevel::transform_point(center, prev_tail);
-	} else {
-		tmp_current_tail = current_tail;
-		tmp_prev_tail = prev_tail;
+void SecondaryGizmo::_update_frustum() {
+	frustum_planes.clear();
+	if (!is_inside_tree()) {
+		return;
 	}
-
-	// Integration of velocity verlet
-	Vector3 next_tail = tmp_current_tail + (tmp_current_tail - tmp_prev_tail) * (1.0 - drag_force) + (get_rotation(skel).xform(bone_axis)) * stiffness_force + external;
-
-	// Limiting bone length
-	Vector3 origin = get_transform(skel).origin;
-	next_tail = origin + (next_tail - origin).normalized() * length;
-
-	// Collision movement
-	next_tail = collision(skel, colliders, next_tail);
-
-	// Recording current tails for next process
-	if (Variant(center).get_type() != Variant::Type::NIL) {
-		prev_tail = VRMTopLevel::inv_transform_point(center, current_tail);
-		current_tail = VRMTopLevel::inv_transform_point(center, next_tail);
-	} else {
-		prev_tail = current_tail;
-		current_tail = next_tail;
-	}
-
-	// Apply rotation
-	Quaternion ft = VRMTopLevel::from_to_rotation((get_rotation(skel).xform(bone_axis)), next_tail - get_transform(skel).origin);
-	ft = skel->get_relative_transform(skel->get_parent()).basis.get_rotation_quaternion().inverse() * ft;
-	Quaternion qt = ft * get_rotation(skel);
-	Transform3D local_tr = get_local_transform(skel);
-	local_tr.basis = Basis(qt.normalized());
-	skel->set_bone_global_pose_override(bone_idx, local_tr, 1.0, true);
-}
-Vector3 VRMSpringBoneLogic::collision(Skeleton3D *skel, Vector<Ref<SphereCollider>> colliders, Vector3 next_tail) {
-	Vector3 out = next_tail;
-	for (Ref<SphereCollider> collider : colliders) {
-		real_t r = radius + collider->get_radius();
-		Vector3 diff = out - collider->get_position();
-		if ((diff.x * diff.x + diff.y * diff.y + diff.z * diff.z) <= r * r) {
-			// Hit, move to orientation of normal
-			Vector3 normal = (out - collider->get_position()).normalized();
-			Vector3 pos_from_collider = collider->get_position() + normal * (radius + collider->get_radius());
-			// Limiting bone length
-			Vector3 origin = get_transform(skel).origin;
-			out = origin + (pos_from_collider - origin).normalized() * length;
+	if (Engine::get_singleton()->is_editor_hint()) {
+		// Every 3D editor viewport on screen.
+		Node3DEditor *node_3d_editor = Node3DEditor::get_singleton();
+		for (uint32_t viewport_i = 0; node_3d_editor && viewport_i < Node3DEditor::VIEWPORTS_COUNT; viewport_i++) {
+			Node3DEditorViewport *editor_viewport = node_3d_editor->get_editor_viewport(viewport_i);
+			if (editor_viewport && editor_viewport->is_visible_in_tree()) {
+				_add_camera_frustum(editor_viewport->get_camera_3d());
+			}
 		}
+	} else if (get_viewport()) {
+		_add_camera_frustum(get_viewport()->get_camera_3d());
 	}
-	return out;
 }
-void VRMSecondary::_notification(int p_what) {
-	switch (p_what) {
-		case NOTIFICATION_READY: {
-			bool gizmo_spring_bone = false;
-			VRMTopLevel *vrm_top_level = cast_to<VRMTopLevel>(get_parent());
-			if (vrm_top_level) {
-				update_secondary_fixed = vrm_top_level->get_update_secondary_fixed();
-				gizmo_spring_bone = vrm_top_level->get_gizmo_spring_bone();
-			}
-			if (secondary_gizmo == nullptr && (Engine::get_singleton()->is_editor_hint() || gizmo_spring_bone)) {
-				secondary_gizmo = memnew(SecondaryGizmo(this));
-				add_child(secondary_gizmo, true);
-			}
-			collider_groups_internal.clear();
-			spring_bones_internal.clear();
-			for (Ref<VRMColliderGroup> collider_group : collider_groups) {
-				Ref<VRMColliderGroup> new_collider_group = collider_group->duplicate(true);
-				Skeleton3D *parent = cast_to<Skeleton3D>(get_node_or_null(new_collider_group->skeleton_or_node));
-				if (parent) {
-					new_collider_group->_ready(parent, parent);
-					collider_groups_internal.append(new_collider_group);
-				}
-			}
-			for (Ref<VRMSpringBone> spring_bone : spring_bones) {
-				Ref<VRMSpringBone> new_spring_bone = spring_bone->duplicate(true);
-				Vector<Ref<SphereCollider>> tmp_colliders;
-				for (int32_t collider_i = 0; collider_i < collider_groups.size(); collider_i++) {
-					if (new_spring_bone->collider_groups.has(collider_groups[collider_i])) {
-						tmp_colliders.append_array(collider_groups_internal[collider_i]->colliders);
-					}
-				}
-				Skeleton3D *skel = cast_to<Skeleton3D>(get_node_or_null(new_spring_bone->skeleton));
-				if (skel) {
-					new_spring_bone->_ready(skel, tmp_colliders);
-					spring_bones_internal.append(new_spring_bone);
-				}
-			}
-		} break;
-		case NOTIFICATION_PROCESS: {
-			if (!update_secondary_fixed) {
-				return;
-			}
-			if (!Engine::get_singleton()->is_editor_hint() || check_for_editor_update()) {
-				// Force update the skeleton.
-				for (Ref<VRMSpringBone> spring_bone : spring_bones_internal) {
-					if (spring_bone->skel) {
-						spring_bone->skel->get_bone_global_pose_no_override(0);
-					}
-				}
-				for (Ref<VRMColliderGroup> collider_group : collider_groups_internal) {
-					collider_group->_process();
-				}
-				for (Ref<VRMSpringBone> spring_bone : spring_bones_internal) {
-					spring_bone->_process(get_process_delta_time());
-				}
-				if (secondary_gizmo) {
-					if (Engine::get_singleton()->is_editor_hint()) {
-						secondary_gizmo->draw_in_editor(true);
-					} else {
-						secondary_gizmo->draw_in_game();
-					}
-				}
-			} else if (Engine::get_singleton()->is_editor_hint()) {
-				if (secondary_gizmo) {
-					secondary_gizmo->draw_in_editor();
-				}
-			}
-		} break;
-		case NOTIFICATION_PHYSICS_PROCESS: {
-			if (!update_secondary_fixed) {
-				return;
-			}
-			if (!Engine ::get_singleton()->is_editor_hint() || check_for_editor_update()) {
-				// Force the skeleton update.
-				for (Ref<VRMSpringBone> spring_bone : spring_bones_internal) {
-					if (spring_bone->skel) {
-						spring_bone->skel->get_bone_global_pose_no_override(0);
-					}
-				}
-				for (Ref<VRMColliderGroup> collider_group : collider_groups_internal) {
-					collider_group->_process();
-				}
-				for (Ref<VRMSpringBone> spring_bone : spring_bones_internal) {
-					spring_bone->_process(get_physics_process_delta_time());
-				}
-				if (secondary_gizmo) {
-					if (Engine::get_singleton()->is_editor_hint()) {
-						secondary_gizmo->draw_in_editor(true);
-					} else {
-						secondary_gizmo->draw_in_game();
-					}
-				} else if (Engine::get_singleton()->is_editor_hint()) {
-					if (secondary_gizmo) {
-						secondary_gizmo->draw_in_editor();
-					}
-				}
-			}
-		} break;
+bool SecondaryGizmo::_is_visible(const Vector3 &p_center, real_t p_radius) const {
+	if (frustum_planes.is_empty()) {
+		return true;
+	}
+	for (uint32_t frustum_i = 0; frustum_i < frustum_planes.size(); frustum_i += 6) {
+		bool inside = true;
+		for (uint32_t plane_i = frustum_i; inside && plane_i < frustum_i + 6; plane_i++) {
+			inside = frustum_planes[plane_i].distance_to(p_center) <= p_radius;
+		}
+		if (inside) {
+			return true;
+		}
 	}
+	return false;
 }
-bool VRMSecondary::check_for_editor_update() {
-	if (!Engine::get_singleton()->is_editor_hint()) {
+bool SecondaryGizmo::_needs_redraw(VRMTopLevel *p_vrm_top_level, bool p_draw) {
+	if (p_draw != redraw_drawn) {
+		return true;
+	}
+	if (!p_draw) {
+		// Already cleared.
 		return false;
 	}
-	Node *parent = get_parent();
-	VRMTopLevel *vrm_top_level = cast_to<VRMTopLevel>(parent);
-	if (vrm_top_level) {
-		if (vrm_top_level->get_update_in_editor() && !update_in_editor) {
-			update_in_editor = true;
-			_notification(NOTIFICATION_READY);
-		}
+	const int redraw_rate = p_vrm_top_level->get_gizmo_spring_bone_redraw_rate();
+	if (redraw_rate > 0 && OS::get_singleton()->get_ticks_usec() - redraw_usec < uint64_t(1000000 / redraw_rate)) {
+		return false;
 	}
-	if (!parent->get("update_in_editor") && update_in_editor) {
-		update_in_editor = false;
-		for (Ref<VRMSpringBone> spring_bone : spring_bones_internal) {
-			spring_bone->skel->clear_bones_global_pose_override();
+	const real_t threshold = p_vrm_top_level->get_gizmo_spring_bone_redraw_threshold();
+	if (threshold <= 0) {
+		return true;
+	}
+	// A moved camera or gizmo changes what is culled.
+	if (frustum_planes.size() != redraw_frustum_planes.size()) {
+		return true;
+	}
+	for (uint32_t plane_i = 0; plane_i < frustum_planes.size(); plane_i++) {
+		if (!frustum_planes[plane_i].is_equal_approx(redraw_frustum_planes[plane_i])) {
+			return true;
 		}
 	}
-	return update_in_editor;
-}
-void VRMSpringBone::setup(bool force) {
-	if (!(!root_bones.is_empty() && skel)) {
-		return;
+	const VRMSpringBoneServer::Avatar *avatar = VRMSpringBoneServer::get_singleton()->avatar_get(secondary_node->avatar);
+	if (!avatar) {
+		return true;
 	}
-	if (!(force || verlets.is_empty())) {
-		return;
+	const uint32_t collider_count = avatar->colliders.external_begin;
+	if (redraw_points.size() != avatar->joints.size() + collider_count) {
+		return true;
 	}
-	if (!verlets.is_empty()) {
-		for (Ref<VRMSpringBoneLogic> verlet : verlets) {
-			if (verlet.is_null()) {
-				continue;
-			}
-			verlet->reset(skel);
+	for (uint32_t joint_i = 0; joint_i < avatar->joints.size(); joint_i++) {
+		if (avatar->written_tails.get(joint_i).distance_squared_to(redraw_points[joint_i]) > threshold * threshold) {
+			return true;
 		}
 	}
-	verlets.clear();
-	for (String go : root_bones) {
-		if (go.is_empty()) {
-			setup_recursive(skel->find_bone(go), center);
+	for (uint32_t collider_i = 0; collider_i < collider_count; collider_i++) {
+		if (avatar->colliders.positions.get(collider_i).distance_squared_to(redraw_points[avatar->joints.size() + collider_i]) > threshold * threshold) {
+			return true;
 		}
 	}
+	return false;
 }
-void VRMSpringBone::setup_recursive(int id, Variant center_tr) {
-	if (skel->get_bone_children(id).is_empty()) {
-		Vector3 delta = skel->get_bone_rest(id).origin;
-		Vector3 child_position = delta.normalized() * 0.07;
-		Ref<VRMSpringBoneLogic> spring_bone_logic;
-		spring_bone_logic.instantiate();
-		spring_bone_logic->setup(skel, id, center_tr, child_position, skel->get_bone_global_pose_no_override(id));
-		verlets.append(spring_bone_logic);
-	} else {
-		int first_child = skel->get_bone_children(id)[0];
-		Vector3 local_position = skel->get_bone_rest(first_child).origin;
-		// TODO: Use full names for variables.
-		Vector3 sca = skel->get_bone_rest(first_child).basis.get_scale();
-		Vector3 pos = Vector3(local_position.x * sca.x, local_position.y * sca.y, local_position.z * sca.z);
-		Ref<VRMSpringBoneLogic> spring_bone_logic;
-		spring_bone_logic.instantiate();
-		spring_bone_logic->setup(skel, id, center_tr, pos, skel->get_bone_global_pose_no_override(id));
-		verlets.append(spring_bone_logic);
+void SecondaryGizmo::_redraw(VRMTopLevel *p_vrm_top_level, bool p_draw) {
+	if (p_draw) {
+		_update_frustum();
 	}
-	for (int child : skel->get_bone_children(id)) {
-		setup_recursive(child, center_tr);
+	if (!_needs_redraw(p_vrm_top_level, p_draw)) {
+		return;
 	}
-}
-void VRMSpringBone::_ready(Skeleton3D *ready_skel, Vector<Ref<SphereCollider>> colliders_ref) {
-	if (ready_skel) {
-		skel = ready_skel;
+	_begin_draw();
+	if (p_draw) {
+		draw_spring_bones(p_vrm_top_level->get_gizmo_spring_bone_color());
+		draw_collider_groups();
+	}
+	_end_draw();
+	redraw_drawn = p_draw;
+	redraw_usec = OS::get_singleton()->get_ticks_usec();
+	redraw_frustum_planes = frustum_planes;
+	// Compared against by the redraw threshold.
+	redraw_points.clear();
+	const VRMSpringBoneServer::Avatar *avatar = p_draw ? VRMSpringBoneServer::get_singleton()->avatar_get(secondary_node->avatar) : nullptr;
+	if (avatar) {
+		for (uint32_t joint_i = 0; joint_i < avatar->joints.size(); joint_i++) {
+			redraw_points.push_back(avatar->written_tails.get(joint_i));
+		}
+		for (uint32_t collider_i = 0; collider_i < avatar->colliders.external_begin; collider_i++) {
+			redraw_points.push_back(avatar->colliders.positions.get(collider_i));
+		}
 	}
-	setup();
-	colliders = colliders_ref;
 }
-void VRMSpringBone::_process(double delta) {
-	if (verlets.is_empty()) {
-		if (root_bones.is_empty()) {
-			return;
+void SecondaryGizmo::_begin_draw() {
+	sphere_count = 0;
+	line_vertices.clear();
+	line_colors.clear();
+}
+void SecondaryGizmo::_end_draw() {
+	Ref<ArrayMesh> array_mesh = get_mesh();
+	if (array_mesh.is_valid()) {
+		array_mesh->clear_surfaces();
+		if (line_vertices.size()) {
+			Array arrays;
+			arrays.resize(Mesh::ARRAY_MAX);
+			arrays[Mesh::ARRAY_VERTEX] = line_vertices;
+			arrays[Mesh::ARRAY_COLOR] = line_colors;
+			array_mesh->add_surface_from_arrays(Mesh::PRIMITIVE_LINES, arrays);
 		}
-		setup();
 	}
-	float stiffness = stiffness_force * delta;
-	Vector3 external = gravity_dir * (gravity_power * delta);
-	for (Ref<VRMSpringBoneLogic> verlet : verlets) {
-		verlet->radius = hit_radius;
-		verlet->update(skel, center, stiffness, drag_force, external, colliders);
+	// The instance count follows the buffer, which only grows; instances
+	// past sphere_count are hidden.
+	if (sphere_multimesh->get_instance_count() * 16 != sphere_buffer.size()) {
+		sphere_multimesh->set_instance_count(sphere_buffer.size() / 16);
+	}
+	sphere_multimesh->set_visible_instance_count(sphere_count);
+	if (sphere_count) {
+		sphere_multimesh->set_buffer(sphere_buffer);
 	}
-}
-SecondaryGizmo::SecondaryGizmo(Node *p_parent) {
-	set_mesh(memnew(ImmediateMesh));
-	secondary_node = cast_to<VRMSecondary>(p_parent);
-	m->set_depth_draw_mode(StandardMaterial3D::DEPTH_DRAW_DISABLED);
-	m->set_shading_mode(BaseMaterial3D::SHADING_MODE_UNSHADED);
-	m->set_flag(BaseMaterial3D::FLAG_ALBEDO_FROM_VERTEX_COLOR, true);
-	m->set_transparency(BaseMaterial3D::TRANSPARENCY_ALPHA);
 }
 void SecondaryGizmo::draw_collider_groups() {
-	Ref<ImmediateMesh> immediate_mesh = get_mesh();
-	if (immediate_mesh.is_null()) {
-		return;
-	}
 	set_material_override(m);
-	Array collider_group_internal;
-
-	if (secondary_node->collider_groups.size()) {
-		collider_group_internal = secondary_node->get("collider_groups_internal");
+	const VRMSpringBoneServer::Avatar *avatar = VRMSpringBoneServer::get_singleton()->avatar_get(secondary_node->avatar);
+	if (!avatar) {
+		return;
 	}
 
-	for (int32_t collider_group_i = 0; collider_group_i < collider_group_internal.size(); collider_group_i++) {
-		VRMColliderGroup *collider_group = cast_to<VRMColliderGroup>(collider_group_internal[collider_group_i]);
+	for (int32_t collider_group_i = 0; collider_group_i < avatar->collider_groups.size(); collider_group_i++) {
+		VRMColliderGroup *collider_group = avatar->collider_groups[collider_group_i].ptr();
 		if (!collider_group) {
 			continue;
 		}
-		immediate_mesh->surface_begin(Mesh::PRIMITIVE_LINE_STRIP);
 		Transform3D c_tr;
 		if (Engine::get_singleton()->is_editor_hint()) {
-			Skeleton3D *c_sk = cast_to<Skeleton3D>(secondary_node->get_node_or_null(collider_group->skeleton_or_node));
-			if (c_sk) {
-				if (collider_group->bone_idx == -1) {
-					collider_group->bone_idx = c_sk->find_bone(collider_group->bone);
-				}
+			Node3D *c_node = cast_to<Node3D>(secondary_node->get_node_or_null(collider_group->skeleton_or_node));
+			Skeleton3D *c_sk = cast_to<Skeleton3D>(c_node);
+			if (c_sk && collider_group->bone_idx == -1) {
+				collider_group->bone_idx = c_sk->find_bone(collider_group->bone);
+			}
+			if (c_sk && collider_group->bone_idx != -1) {
 				c_tr = c_sk->get_bone_global_pose(collider_group->bone_idx);
+			} else if (c_node) {
+				c_tr = c_node->get_relative_transform(c_node->get_parent());
 			}
-		} else if (collider_group->skel && cast_to<Skeleton3D>(collider_group->parent)) {
-			c_tr = collider_group->skel->get_bone_global_pose_no_override(cast_to<Skeleton3D>(collider_group->parent)->find_bone(collider_group->bone));
+		} else if (collider_group->skel && collider_group->bone_idx != -1) {
+			c_tr = collider_group->skel->get_bone_global_pose_no_override(collider_group->bone_idx);
+		} else if (collider_group->parent) {
+			c_tr = collider_group->frame_transform;
 		}
 		for (int32_t sphere_collider_i = 0; sphere_collider_i < collider_group->sphere_colliders.size(); sphere_collider_i++) {
 			Vector4 collider = collider_group->sphere_colliders[sphere_collider_i];
-			// UniVRM will match XY-axis between Unity and OpenGL, so Z-axis will be flipped.
-			// The coordinate issue may be fixed in VRM 1.0 or later.
-			// https://github.com/vrm-c/vrm-specification/issues/205
-			Vector3 c_ps = Vector3(collider.x, collider.y, -collider.z);
-			draw_sphere(c_tr.basis, VRMTopLevel::transform_point(c_tr, c_ps), collider.w, collider_group->gizmo_color);
+			// Already in Godot's axes, the importer applies the UniVRM Z flip.
+			Vector3 c_ps = Vector3(collider.x, collider.y, collider.z);
+			if (_is_visible(c_tr.xform(c_ps), collider.w)) {
+				draw_sphere(c_tr.basis, c_tr.xform(c_ps), collider.w, collider_group->gizmo_color);
+			}
+		}
+		for (int32_t capsule_collider_i = 0; capsule_collider_i < MIN(collider_group->capsule_colliders.size(), collider_group->capsule_collider_tails.size()); capsule_collider_i++) {
+			Vector4 collider = collider_group->capsule_colliders[capsule_collider_i];
+			Vector3 tail = collider_group->capsule_collider_tails[capsule_collider_i];
+			const Vector3 head = c_tr.xform(Vector3(collider.x, collider.y, collider.z));
+			const Vector3 capsule_tail = c_tr.xform(tail);
+			if (_is_visible((head + capsule_tail) * 0.5, head.distance_to(capsule_tail) * 0.5 + collider.w)) {
+				draw_capsule(c_tr.basis, head, capsule_tail, collider.w, collider_group->gizmo_color);
+			}
+		}
+		for (int32_t plane_collider_i = 0; plane_collider_i < collider_group->plane_colliders.size(); plane_collider_i++) {
+			Plane collider = collider_group->plane_colliders[plane_collider_i];
+			const Vector3 center = c_tr.xform(collider.get_center());
+			// The drawn square and normal fit in twice the size.
+			if (_is_visible(center, 0.5)) {
+				draw_plane(c_tr.basis, center, c_tr.basis.xform(collider.normal).normalized(), 0.25, collider_group->gizmo_color);
+			}
 		}
-		immediate_mesh->surface_end();
 	}
 }
 void SecondaryGizmo::draw_line(Vector3 begin_pos, Vector3 end_pos, Color color) {
-	Ref<ImmediateMesh> immediate_mesh = get_mesh();
-	if (immediate_mesh.is_null()) {
-		return;
-	}
-	immediate_mesh->surface_set_color(color);
-	immediate_mesh->surface_add_vertex(begin_pos);
-	immediate_mesh->surface_set_color(color);
-	immediate_mesh->surface_add_vertex(end_pos);
+	line_vertices.push_back(begin_pos);
+	line_colors.push_back(color);
+	line_vertices.push_back(end_pos);
+	line_colors.push_back(color);
 }
 void SecondaryGizmo::draw_sphere(Basis bas, Vector3 center, float radius, Color color) {
-	Ref<ImmediateMesh> immediate_mesh = get_mesh();
-	if (immediate_mesh.is_null()) {
-		return;
+	if ((sphere_count + 1) * 16 > sphere_buffer.size()) {
+		sphere_buffer.resize(next_power_of_2(sphere_count + 1) * 16);
 	}
-	const int step = 15;
-	float sppi = 2.0f * Math_PI / step;
-	const Vector3 UP = Vector3(0.0, 1.0, 0.0);
-	const Vector3 RIGHT = Vector3(1.0, 0.0, 0.0);
-	const Vector3 FORWARD = Vector3(0.0, 0.0, -1.0);
-	for (int32_t step_i = 0; step_i < step + 1; step_i++) {
-		immediate_mesh->surface_set_color(color);
-		immediate_mesh->surface_add_vertex(center + (bas.xform(UP) * radius).rotated(bas.xform(RIGHT), sppi * (step_i % step)));
+	// Oriented like the bone, scaled only by the radius.
+	const Basis sphere_basis = bas.orthonormalized() * radius;
+	float *instance = sphere_buffer.ptrw() + sphere_count * 16;
+	for (int row_i = 0; row_i < 3; row_i++) {
+		instance[row_i * 4 + 0] = sphere_basis.rows[row_i].x;
+		instance[row_i * 4 + 1] = sphere_basis.rows[row_i].y;
+		instance[row_i * 4 + 2] = sphere_basis.rows[row_i].z;
+		instance[row_i * 4 + 3] = center[row_i];
 	}
-	for (int32_t step_i = 0; step_i < step + 1; step_i++) {
-		immediate_mesh->surface_set_color(color);
-		immediate_mesh->surface_add_vertex(center + (bas.xform(RIGHT) * radius).rotated(bas.xform(FORWARD), sppi * (step_i % step)));
+	instance[12] = color.r;
+	instance[13] = color.g;
+	instance[14] = color.b;
+	instance[15] = color.a;
+	sphere_count++;
+}
+void SecondaryGizmo::draw_capsule(Basis bas, Vector3 head, Vector3 tail, float radius, Color color) {
+	// Both end spheres; the line strip joins them along the axis.
+	draw_sphere(bas, head, radius, color);
+	draw_sphere(bas, tail, radius, color);
+	Vector3 axis = tail - head;
+	if (axis.is_zero_approx()) {
+		return;
 	}
-	for (int32_t step_i = 0; step_i < step + 1; step_i++) {
-		immediate_mesh->surface_set_color(color);
-		immediate_mesh->surface_add_vertex(center + (bas.xform(FORWARD) * radius).rotated(bas.xform(UP), sppi * (step_i % step)));
+	Vector3 side = axis.cross(bas.xform(Vector3(0.0, 1.0, 0.0)));
+	if (side.is_zero_approx()) {
+		side = axis.cross(bas.xform(Vector3(1.0, 0.0, 0.0)));
+	}
+	side = side.normalized() * radius;
+	draw_line(tail + side, head + side, color);
+	draw_line(head - side, tail - side, color);
+}
+void SecondaryGizmo::draw_plane(Basis bas, Vector3 center, Vector3 normal, float size, Color color) {
+	Vector3 tangent = normal.cross(bas.xform(Vector3(0.0, 0.0, -1.0)));
+	if (tangent.is_zero_approx()) {
+		tangent = normal.cross(bas.xform(Vector3(1.0, 0.0, 0.0)));
 	}
+	tangent = tangent.normalized() * size;
+	Vector3 bitangent = normal.cross(tangent).normalized() * size;
+	draw_line(center + tangent + bitangent, center - tangent + bitangent, color);
+	draw_line(center - tangent - bitangent, center + tangent - bitangent, color);
+	draw_line(center + tangent + bitangent, center, color);
+	draw_line(center + normal * size, center, color);
 }
 void SecondaryGizmo::draw_in_editor(bool p_do_draw_spring_bones) {
-	Ref<ImmediateMesh> immediate_mesh = get_mesh();
-	if (immediate_mesh.is_valid()) {
-		immediate_mesh->clear_surfaces();
+	VRMTopLevel *vrm_top_level = secondary_node ? cast_to<VRMTopLevel>(secondary_node->get_parent()) : nullptr;
+	bool draw = vrm_top_level && vrm_top_level->get_gizmo_spring_bone();
+	if (draw && vrm_top_level->get_gizmo_spring_bone_selected_only()) {
+		EditorSelection *editor_selection = EditorNode::get_singleton()->get_editor_selection();
+		draw = editor_selection && editor_selection->is_selected(vrm_top_level);
+	}
+	_redraw(vrm_top_level, draw);
+}
+void SecondaryGizmo::draw_in_game() {
+	VRMTopLevel *vrm_top_level = secondary_node ? cast_to<VRMTopLevel>(secondary_node->get_parent()) : nullptr;
+	_redraw(vrm_top_level, vrm_top_level && vrm_top_level->get_gizmo_spring_bone());
+}
+Ref<Resource> VRMColliderGroup::duplicate(bool p_subresources) const {
+	Ref<VRMColliderGroup> collider_group;
+	collider_group.instantiate();
+	collider_group->set_name(get_name());
+	collider_group->skeleton_or_node = skeleton_or_node;
+	collider_group->bone = bone;
+	collider_group->sphere_colliders = sphere_colliders;
+	collider_group->capsule_colliders = capsule_colliders;
+	collider_group->capsule_collider_tails = capsule_collider_tails;
+	collider_group->plane_colliders = plane_colliders;
+	collider_group->gizmo_color = gizmo_color;
+	return collider_group;
+}
+void VRMColliderGroup::setup(VRMColliderTable &r_colliders) {
+	r_colliders.groups.push_back(this);
+	collider_begin = r_colliders.size();
+	for (const Vector4 &collider : sphere_colliders) {
+		r_colliders.add_collider(VRMColliderTable::SHAPE_SPHERE, Vector3(collider.x, collider.y, collider.z), Vector3(), collider.w);
+	}
+	capsule_begin = r_colliders.size();
+	if (capsule_collider_tails.size() != capsule_colliders.size()) {
+		ERR_PRINT("Capsule colliders and their tails differ in count.");
+	} else {
+		for (int32_t capsule_i = 0; capsule_i < capsule_colliders.size(); capsule_i++) {
+			const Vector4 &collider = capsule_colliders[capsule_i];
+			r_colliders.add_collider(VRMColliderTable::SHAPE_CAPSULE, Vector3(collider.x, collider.y, collider.z), capsule_collider_tails[capsule_i], collider.w);
+		}
+	}
+	plane_begin = r_colliders.size();
+	for (const Plane &collider : plane_colliders) {
+		r_colliders.add_collider(VRMColliderTable::SHAPE_PLANE, collider.get_center(), collider.normal.normalized(), 0.0f);
+	}
+	collider_end = r_colliders.size();
+	local_extent = 0;
+	for (uint32_t collider_i = collider_begin; collider_i < collider_end; collider_i++) {
+		local_extent = MAX(local_extent, r_colliders.local_positions.get(collider_i).length());
+		local_extent = MAX(local_extent, r_colliders.local_tails.get(collider_i).length());
+	}
+	// No previous transform yet.
+	frame_motion = -1;
+}
+void VRMColliderGroup::_ready(Node3D *p_parent, VRMColliderTable &r_colliders) {
+	parent = p_parent;
+	skel = cast_to<Skeleton3D>(p_parent);
+	bone_idx = skel ? skel->find_bone(bone) : -1;
+	setup(r_colliders);
+}
+void VRMColliderGroup::_process(const VRMSkeletonPose *p_pose, VRMColliderTable &r_colliders) {
+	Transform3D transform;
+	if (bone_idx != -1) {
+		transform = p_pose ? p_pose->get_bone_transform(bone_idx) : skel->get_relative_transform(skel->get_parent()) * skel->get_bone_global_pose(bone_idx);
+	} else {
+		// A plain node, read once per step.
+		transform = parent->get_relative_transform(parent->get_parent());
+	}
+	// Points move by at most the origin delta plus the basis delta times
+	// their distance; plane normals by at most the basis delta.
+	if (frame_motion < 0) {
+		frame_motion = Math_INF;
+	} else {
+		const Basis basis_delta = transform.basis - frame_transform.basis;
+		const real_t basis_motion = Math::sqrt(basis_delta.rows[0].length_squared() + basis_delta.rows[1].length_squared() + basis_delta.rows[2].length_squared());
+		frame_motion = transform.origin.distance_to(frame_transform.origin) + basis_motion * MAX(local_extent, real_t(1.0));
 	}
-	if (!secondary_node) {
+	frame_transform = transform;
+	if (collider_begin == collider_end) {
 		return;
 	}
-	VRMTopLevel *vrm_top_level = cast_to<VRMTopLevel>(secondary_node->get_parent());
-	if (vrm_top_level->get_parent() && vrm_top_level->get_parent()->get("get_gizmo_spring_bone")) {
-		draw_spring_bones(vrm_top_level->get_gizmo_spring_bone_color());
-		draw_collider_groups();
+	r_colliders.positions.set_xformed(r_colliders.local_positions, transform, collider_begin, collider_end);
+	r_colliders.tails.set_xformed(r_colliders.local_tails, transform, capsule_begin, plane_begin);
+	for (uint32_t collider_i = plane_begin; collider_i < collider_end; collider_i++) {
+		r_colliders.tails.set(collider_i, transform.basis.xform(r_colliders.local_tails.get(collider_i)).normalized());
+	}
+	if (plane_begin != collider_end) {
+		// Planes are unbounded; the group never culls.
+		bound_center = r_colliders.positions.get(plane_begin);
+		bound_radius = Math_INF;
+		return;
+	}
+	AABB bounds(r_colliders.positions.get(collider_begin), Vector3());
+	for (uint32_t collider_i = collider_begin; collider_i < collider_end; collider_i++) {
+		bounds.expand_to(r_colliders.positions.get(collider_i));
+		if (collider_i >= capsule_begin) {
+			bounds.expand_to(r_colliders.tails.get(collider_i));
+		}
+	}
+	bound_center = bounds.get_center();
+	bound_radius = 0;
+	for (uint32_t collider_i = collider_begin; collider_i < collider_end; collider_i++) {
+		real_t distance = bound_center.distance_to(r_colliders.positions.get(collider_i));
+		if (collider_i >= capsule_begin) {
+			distance = MAX(distance, bound_center.distance_to(r_colliders.tails.get(collider_i)));
+		}
+		bound_radius = MAX(bound_radius, distance + r_colliders.radii[collider_i]);
 	}
 }
-void SecondaryGizmo::draw_in_game() {
-	Ref<ImmediateMesh> immediate_mesh = get_mesh();
-	if (immediate_mesh.is_valid()) {
-		immediate_mesh->clear_surfaces();
+void VRMSkeletonPose::track_bone(int32_t p_bone) {
+	if (p_bone < 0 || bones.has(p_bone)) {
+		return;
+	}
+	bones.push_back(p_bone);
+	if (bone_global_poses.size() <= uint32_t(p_bone)) {
+		bone_global_poses.resize(p_bone + 1);
+	}
+	capture_order_dirty = true;
+}
+void VRMSkeletonPose::track_override_bone(int32_t p_bone) {
+	if (p_bone < 0 || override_bones.has(p_bone)) {
+		return;
 	}
-	if (!secondary_node) {
+	override_bones.push_back(p_bone);
+	if (bone_overrides.size() <= uint32_t(p_bone)) {
+		bone_overrides.resize(p_bone + 1);
+		bone_override_amounts.resize(p_bone + 1);
+	}
+	bone_override_amounts[p_bone] = 0;
+}
+void VRMSkeletonPose::commit() {
+	// The overrides are persistent, so the skeleton marks itself dirty once
+	// and recomputes its global poses on its next update.
+	if (!ObjectDB::get_instance(skeleton_id)) {
 		return;
 	}
-	VRMTopLevel *vrm_top_level = cast_to<VRMTopLevel>(secondary_node->get_parent());
-	if (vrm_top_level->get_parent() && vrm_top_level->get_parent()->get("gizmo_spring_bone")) {
-		draw_spring_bones(vrm_top_level->get("gizmo_spring_bone_color"));
-		draw_collider_groups();
+	for (uint32_t bone_i = 0; bone_i < override_bones.size(); bone_i++) {
+		const int32_t bone = override_bones[bone_i];
+		skeleton->set_bone_global_pose_override(bone, bone_overrides[bone], bone_override_amounts[bone], true);
 	}
 }
-void VRMColliderGroup::setup() {
-	if (parent == nullptr) {
+void VRMSkeletonPose::release_overrides() {
+	if (!ObjectDB::get_instance(skeleton_id)) {
 		return;
 	}
-	colliders.clear();
-	for (const Vector4 &collider : sphere_colliders) {
-		Ref<SphereCollider> collider_single;
-		collider_single.instantiate();
-		collider_single->_ready(bone_idx, Vector3(collider.x, collider.y, collider.z), collider.w);
-		colliders.append(collider_single);
+	for (uint32_t bone_i = 0; bone_i < override_bones.size(); bone_i++) {
+		const int32_t bone = override_bones[bone_i];
+		bone_override_amounts[bone] = 0.0;
+		skeleton->set_bone_global_pose_override(bone, Transform3D(), 0.0, true);
 	}
 }
-void VRMColliderGroup::_ready(Node3D *ready_parent, Skeleton3D *ready_skel) {
-	// TODO: Why is there a duplicate variable here?
-	parent = ready_parent;
-	if (ready_parent->get_class() == "Skeleton3D") {
-		skel = ready_skel;
-		bone_idx = cast_to<Skeleton3D>(ready_parent)->find_bone(bone);
+void VRMSkeletonPose::build_capture_order() {
+	capture_bones.clear();
+	capture_parents.clear();
+	bone_global_poses.resize(skeleton->get_bone_count());
+	LocalVector<uint8_t> added;
+	added.resize(skeleton->get_bone_count());
+	memset(added.ptr(), 0, added.size());
+	for (uint32_t bone_i = 0; bone_i < bones.size(); bone_i++) {
+		add_capture_bone(bones[bone_i], added);
+	}
+	capture_order_dirty = false;
+}
+void VRMSkeletonPose::add_capture_bone(int32_t p_bone, LocalVector<uint8_t> &r_added) {
+	if (p_bone < 0 || r_added[p_bone]) {
+		return;
 	}
-	setup();
+	const int32_t parent = skeleton->get_bone_parent(p_bone);
+	add_capture_bone(parent, r_added);
+	r_added[p_bone] = 1;
+	capture_bones.push_back(p_bone);
+	capture_parents.push_back(parent);
 }
-void VRMColliderGroup::_process() {
-	for (Ref<SphereCollider> collider : colliders) {
-		collider->update(parent, skel);
+uint32_t VRMSkeletonPose::capture() {
+	if (capture_order_dirty || bone_global_poses.size() != uint32_t(skeleton->get_bone_count())) {
+		build_capture_order();
+	}
+	skeleton_transform = skeleton->get_relative_transform(skeleton->get_parent());
+	skeleton_rotation_inv = skeleton_transform.basis.get_rotation_quaternion().inverse();
+	// Same composition as the skeleton's own update, so the result matches
+	// get_bone_global_pose_no_override() without triggering that update.
+	for (uint32_t bone_i = 0; bone_i < capture_bones.size(); bone_i++) {
+		const int32_t bone = capture_bones[bone_i];
+		const int32_t parent = capture_parents[bone_i];
+		if (parent == -1) {
+			bone_global_poses[bone] = skeleton->get_bone_pose(bone);
+		} else {
+			bone_global_poses[bone] = bone_global_poses[parent] * skeleton->get_bone_pose(bone);
+		}
 	}
+	return capture_bones.size() + 1;
 }
 void VRMEditorSceneFormatImporter::adjust_mesh_zforward(Ref<ImporterMesh> mesh) {
 	// MESH and SKIN data divide, to compensate for object position multiplying.
@@ -1817,6 +4410,15 @@ void VRMEditorSceneFormatImporter::_add_joints_recursive(Dictionary &new_joints_
 	}
 }
 
+Vector3 VRMEditorSceneFormatImporter::_parse_collider_vector(const Variant &p_value) {
+	// VRM 0.x writes {"x", "y", "z"} objects.
+	if (p_value.get_type() != Variant::DICTIONARY) {
+		return Vector3();
+	}
+	Dictionary vector = p_value;
+	return Vector3(vector.get("x", 0.0), vector.get("y", 0.0), vector.get("z", 0.0));
+}
+
 void VRMEditorSceneFormatImporter::_parse_secondary_node(Node *secondary_node, Dictionary vrm_extension, Ref<GLTFState> gstate, TypedArray<Basis> pose_diffs, bool is_vrm_0) {
 	TypedArray<GLTFNode> nodes = gstate->get_nodes();
 	TypedArray<GLTFSkeleton> skeletons = gstate->get_skeletons();
@@ -1847,10 +4449,11 @@ void VRMEditorSceneFormatImporter::_parse_secondary_node(Node *secondary_node, D
 		}
 		Array colliders = cgroup["colliders"];
 		for (int32_t collider_i = 0; collider_i < colliders.size(); collider_i++) {
-			Ref<SphereCollider> collider_info = colliders[collider_i];
-			Vector3 offset_obj = collider_info->offset;
-			Vector3 local_pos = pose_diff.xform(offset_flip * Vector3(offset_obj.x, offset_obj.y, offset_obj.z));
-			float radius = collider_info->radius;
+			// VRM 0.x colliders are spheres. Capsules and planes are set on the
+			// collider group directly.
+			Dictionary collider_info = colliders[collider_i];
+			Vector3 local_pos = pose_diff.xform(offset_flip * _parse_collider_vector(collider_info.get("offset", Variant())));
+			float radius = collider_info.get("radius", 0.0);
 			collider_group->sphere_colliders.append(Vector4(local_pos.x, local_pos.y, local_pos.z, radius));
 		}
 		collider_groups.append(collider_group);
@@ -32,12 +32,18 @@
 
 #include "modules/register_module_types.h"
 
+#include "core/io/file_access.h"
+#include "core/object/worker_thread_pool.h"
+#include "core/templates/local_vector.h"
+#include "core/templates/rid_owner.h"
+
 #include "editor/editor_node.h"
 
 #include "editor/import/resource_importer_scene.h"
 #include "modules/gltf/extensions/gltf_document_extension.h"
 #include "modules/gltf/gltf_document.h"
 #include "modules/gltf/gltf_state.h"
+#include "scene/3d/multimesh_instance_3d.h"
 #include "scene/resources/bone_map.h"
 #include "scene/resources/immediate_mesh.h"
 
@@ -153,6 +159,53 @@ class VRMTopLevel : public Node3D {
 	bool update_in_editor = false;
 	bool gizmo_spring_bone = false;
 	Color gizmo_spring_bone_color = Color(1, 1, 0.878431, 1);
+	// In the editor, only draw the gizmo while this node is selected.
+	bool gizmo_spring_bone_selected_only = false;
+	// Redraws per second at most, 0 redraws every frame.
+	int gizmo_spring_bone_redraw_rate = 0;
+	// Keeps the last drawing until a joint or collider moved this far, 0
+	// redraws regardless.
+	real_t gizmo_spring_bone_redraw_threshold = 0.0;
+
+public:
+	// Async solves on worker threads while the frame goes on and writes the
+	// result at the start of the next step, one frame late.
+	enum SpringBoneUpdateMode {
+		SPRING_BONE_UPDATE_SERIAL,
+		SPRING_BONE_UPDATE_PARALLEL,
+		SPRING_BONE_UPDATE_ASYNC,
+	};
+
+	// Coarser tiers are picked as the avatar moves away from the camera.
+	enum SpringBoneLOD {
+		SPRING_BONE_LOD_FULL,
+		SPRING_BONE_LOD_HALF_RATE,
+		SPRING_BONE_LOD_QUARTER_RATE,
+		SPRING_BONE_LOD_ROOT_ONLY,
+		SPRING_BONE_LOD_FROZEN,
+	};
+
+private:
+	SpringBoneUpdateMode spring_bone_update_mode = SPRING_BONE_UPDATE_SERIAL;
+	// Below this many joints the parallel mode still solves on the calling thread.
+	int spring_bone_parallel_min_joints = 128;
+	// Simulation rate in fixed step mode, 0 steps once per frame.
+	int spring_bone_fixed_step_rate = 0;
+	int spring_bone_max_substeps = 4;
+	bool spring_bone_lod_enabled = false;
+	// Camera distances at which the half rate, quarter rate, root only and
+	// frozen tiers start.
+	Vector4 spring_bone_lod_distances = Vector4(10, 20, 40, 80);
+	real_t spring_bone_lod_hysteresis = 2.0;
+	real_t spring_bone_lod_blend_time = 0.25;
+	// Optional VisibleOnScreenNotifier3D; the avatar freezes while it is off screen.
+	NodePath spring_bone_lod_visibility_notifier;
+	// Frames a chain has to stay settled before it sleeps, 0 never sleeps.
+	int spring_bone_sleep_frames = 0;
+	real_t spring_bone_sleep_threshold = 0.0005;
+	// Spring bones also collide with the colliders of other avatars that
+	// enable this.
+	bool spring_bone_interaction_enabled = false;
 
 public:
 	NodePath get_vrm_skeleton();
@@ -170,6 +223,36 @@ public:
 	bool get_gizmo_spring_bone();
 	void set_gizmo_spring_bone(bool p_update);
 	Color get_gizmo_spring_bone_color();
+	SpringBoneUpdateMode get_spring_bone_update_mode();
+	void set_spring_bone_update_mode(SpringBoneUpdateMode p_mode);
+	int get_spring_bone_parallel_min_joints();
+	void set_spring_bone_parallel_min_joints(int p_min_joints);
+	int get_spring_bone_fixed_step_rate();
+	void set_spring_bone_fixed_step_rate(int p_step_rate);
+	int get_spring_bone_max_substeps();
+	void set_spring_bone_max_substeps(int p_max_substeps);
+	bool get_spring_bone_lod_enabled();
+	void set_spring_bone_lod_enabled(bool p_enabled);
+	Vector4 get_spring_bone_lod_distances();
+	void set_spring_bone_lod_distances(Vector4 p_distances);
+	real_t get_spring_bone_lod_hysteresis();
+	void set_spring_bone_lod_hysteresis(real_t p_hysteresis);
+	real_t get_spring_bone_lod_blend_time();
+	void set_spring_bone_lod_blend_time(real_t p_blend_time);
+	NodePath get_spring_bone_lod_visibility_notifier();
+	void set_spring_bone_lod_visibility_notifier(NodePath p_path);
+	int get_spring_bone_sleep_frames();
+	void set_spring_bone_sleep_frames(int p_frames);
+	real_t get_spring_bone_sleep_threshold();
+	void set_spring_bone_sleep_threshold(real_t p_threshold);
+	bool get_spring_bone_interaction_enabled();
+	void set_spring_bone_interaction_enabled(bool p_enabled);
+	bool get_gizmo_spring_bone_selected_only();
+	void set_gizmo_spring_bone_selected_only(bool p_selected_only);
+	int get_gizmo_spring_bone_redraw_rate();
+	void set_gizmo_spring_bone_redraw_rate(int p_rate);
+	real_t get_gizmo_spring_bone_redraw_threshold();
+	void set_gizmo_spring_bone_redraw_threshold(real_t p_threshold);
 
 protected:
 	static void _bind_methods();
@@ -178,59 +261,180 @@ public:
 	void set_gizmo_spring_bone_color(Color p_color);
 	static Quaternion from_to_rotation(Vector3 from, Vector3 to);
 
-	static Vector3 transform_point(Transform3D transform, Vector3 point);
-	static Vector3 inv_transform_point(Transform3D transform, Vector3 point);
 };
 
-class SphereCollider : public Resource {
-	GDCLASS(SphereCollider, Resource);
-
-	friend class VRMEditorSceneFormatImporter;
-
-public:
-	int idx = -1;
-	Vector3 offset;
-	float radius = 0.0f;
-	Vector3 position;
-
-	void _ready(int bone_idx, Vector3 collider_offset = Vector3(), float collider_radius = 0.1f);
-	void update(Node3D *parent, Skeleton3D *skel);
-	float get_radius();
-	Vector3 get_position();
+VARIANT_ENUM_CAST(VRMTopLevel::SpringBoneUpdateMode);
+VARIANT_ENUM_CAST(VRMTopLevel::SpringBoneLOD);
+
+// Vector3 array split into one array per component, so the solver kernel
+// can load several joints into a SIMD register at once.
+struct VRMPackedVector3s {
+	LocalVector<real_t> x;
+	LocalVector<real_t> y;
+	LocalVector<real_t> z;
+
+	uint32_t size() const { return x.size(); }
+	void clear();
+	void resize(uint32_t p_size);
+	void push_back(const Vector3 &p_value);
+	Vector3 get(uint32_t p_index) const { return Vector3(x[p_index], y[p_index], z[p_index]); }
+	void set(uint32_t p_index, const Vector3 &p_value) {
+		x[p_index] = p_value.x;
+		y[p_index] = p_value.y;
+		z[p_index] = p_value.z;
+	}
+	// Sets [p_begin, p_end) to the points of p_from transformed by
+	// p_transform, four at a time where SIMD is available.
+	void set_xformed(const VRMPackedVector3s &p_from, const Transform3D &p_transform, uint32_t p_begin, uint32_t p_end);
 };
 
-// Individual spring bone entries.
-class VRMSpringBoneLogic : public RefCounted {
-	GDCLASS(VRMSpringBoneLogic, RefCounted);
-
-	friend class VRMSecondary;
-
-public:
-	bool force_update = true;
-	int bone_idx = -1;
-
-	float radius = 0;
-	float length = 0;
-
-	Vector3 bone_axis;
-	Vector3 current_tail;
-	Vector3 prev_tail;
-
-	Transform3D initial_transform;
-
-	Transform3D get_transform(Skeleton3D *skel);
-	Quaternion get_rotation(Skeleton3D *skel);
-
-	Transform3D get_local_transform(Skeleton3D *skel);
-	Quaternion get_local_rotation(Skeleton3D *skel);
+class VRMColliderGroup;
+
+// Every collider of an avatar, sphere, capsule or plane, grouped by collider
+// group and within a group ordered spheres, capsules, planes. The local columns are written once at
+// setup, the world columns by VRMColliderGroup::_process() every frame.
+struct VRMColliderTable {
+	enum Shape {
+		SHAPE_SPHERE,
+		// Sphere swept from position to tail.
+		SHAPE_CAPSULE,
+		// Infinite plane through position, pushing joints to the side the normal points to.
+		SHAPE_PLANE,
+	};
 
-	void reset(Skeleton3D *skel);
+	// In the space of the group's bone or node.
+	VRMPackedVector3s local_positions;
+	// Capsule tails, or plane normals; unused for spheres.
+	VRMPackedVector3s local_tails;
+	LocalVector<real_t> radii;
+	LocalVector<uint8_t> shapes;
+	VRMPackedVector3s positions;
+	VRMPackedVector3s tails;
+	// Groups in table order. Spring bones select theirs with a bit mask over
+	// these indices, 64 groups per word.
+	LocalVector<const VRMColliderGroup *> groups;
+	// Colliders from external_begin on are copies of other avatars'
+	// colliders, refilled every step and tested by the interacting chains.
+	uint32_t external_begin = 0;
+
+	uint32_t size() const { return shapes.size(); }
+	static bool has_group(const LocalVector<uint64_t> &p_mask, uint32_t p_group) {
+		return (p_group >> 6) < p_mask.size() && (p_mask[p_group >> 6] & (uint64_t(1) << (p_group & 63)));
+	}
+	void clear();
+	void add_collider(Shape p_shape, const Vector3 &p_position, const Vector3 &p_tail, real_t p_radius);
+	void clear_external();
+	// True if the collider can touch a sphere of p_radius at p_center.
+	bool can_reach(uint32_t p_collider, const Vector3 &p_center, real_t p_radius) const {
+		return shape_can_reach(Shape(shapes[p_collider]), positions.get(p_collider), tails.get(p_collider), radii[p_collider], p_center, p_radius);
+	}
+	static bool shape_can_reach(Shape p_shape, const Vector3 &p_position, const Vector3 &p_tail, real_t p_collider_radius, const Vector3 &p_center, real_t p_radius);
+};
 
-	void setup(Skeleton3D *skel, int idx, Variant center, Vector3 local_child_position, Transform3D default_pose);
+class VRMSpringBone;
+
+// One root bone chain: a contiguous, parent first joint range of a spring bone.
+struct VRMSpringBoneChain {
+	VRMSpringBone *spring_bone = nullptr;
+	uint32_t joint_begin = 0;
+	uint32_t joint_end = 0;
+	// Depth levels of the chain. Level i holds the joints
+	// [level_offsets[level_begin + i], level_offsets[level_begin + i + 1]).
+	uint32_t level_begin = 0;
+	uint32_t level_count = 0;
+	// Colliders that can reach the chain this frame, a range of the spring
+	// bone's chain_colliders. Filled by the broadphase in prepare().
+	uint32_t collider_begin = 0;
+	uint32_t collider_end = 0;
+	// Sphere around the root origin that holds every tail of the chain
+	// this frame, from update_chain_bounds().
+	Vector3 bound_center;
+	real_t bound_radius = 0;
+	// Colliders of other avatars are near the chain this frame.
+	bool interacting = false;
+	// Sleep state. A sleeping chain is not solved and keeps its last pose.
+	Transform3D sleep_root_transform;
+	uint32_t settled_frames = 0;
+	bool asleep = false;
+};
 
-	void update(Skeleton3D *skel, Variant center, float stiffness_force, float drag_force, Vector3 external, Vector<Ref<SphereCollider>> colliders);
+// Packed joint storage shared by every spring bone of a VRMSecondary.
+// Joints are appended one root bone chain after another, each chain level
+// by level, so a level only depends on the levels before it.
+struct VRMSpringBoneJoints {
+	LocalVector<int32_t> bone_idx;
+	// Index of the parent joint in this table, -1 for chain roots.
+	LocalVector<int32_t> parent;
+	LocalVector<Vector3> bone_axis;
+	LocalVector<real_t> length;
+	LocalVector<real_t> radius;
+	VRMPackedVector3s current_tail;
+	VRMPackedVector3s prev_tail;
+	LocalVector<uint32_t> level_offsets;
+	// Animated origins seen by the previous sleep check.
+	VRMPackedVector3s sleep_origin;
+
+	// Per frame scratch, filled by the solver before running the kernel.
+	// Animated pose, relative to the parent joint for non-roots.
+	LocalVector<Transform3D> animated_pose;
+	// Upper bound of the distance from the chain root to the joint origin.
+	LocalVector<real_t> reach;
+	VRMPackedVector3s origin;
+	VRMPackedVector3s axis;
+	LocalVector<Quaternion> rotation;
+	VRMPackedVector3s world_current_tail;
+	VRMPackedVector3s world_prev_tail;
+	VRMPackedVector3s next_tail;
+	// Solved pose in skeleton space. Children are posed from it.
+	LocalVector<Transform3D> solved_pose;
+
+	LocalVector<VRMSpringBoneChain> chains;
+
+	uint32_t size() const { return bone_idx.size(); }
+	void clear();
+	uint32_t add_joint(int32_t p_bone_idx, int32_t p_parent);
+};
 
-	Vector3 collision(Skeleton3D *skel, Vector<Ref<SphereCollider>> colliders, Vector3 next_tail);
+// Global bone poses of one skeleton, read once per frame and shared read
+// only by every joint and collider attached to it.
+struct VRMSkeletonPose {
+	Skeleton3D *skeleton = nullptr;
+	// Checked before writing, the skeleton can be deleted before the avatar.
+	ObjectID skeleton_id;
+	// Bones read every frame: the union of the joint and collider bones.
+	LocalVector<int32_t> bones;
+	// The tracked bones and their ancestors, parents first. Their global
+	// poses are composed from the local poses, which unlike the global
+	// getters never force the skeleton to recompute before write back.
+	LocalVector<int32_t> capture_bones;
+	LocalVector<int32_t> capture_parents;
+	bool capture_order_dirty = true;
+	// Indexed by bone, only the entries listed in capture_bones are valid.
+	LocalVector<Transform3D> bone_global_poses;
+	// Skeleton relative to its parent node.
+	Transform3D skeleton_transform;
+	Quaternion skeleton_rotation_inv;
+
+	// Joint bones, and their overrides staged by the spring bones this frame.
+	LocalVector<int32_t> override_bones;
+	LocalVector<Transform3D> bone_overrides;
+	LocalVector<real_t> bone_override_amounts;
+
+	void track_bone(int32_t p_bone);
+	void track_override_bone(int32_t p_bone);
+	void build_capture_order();
+	void add_capture_bone(int32_t p_bone, LocalVector<uint8_t> &r_added);
+	// Returns the number of skeleton queries made.
+	uint32_t capture();
+	Transform3D get_bone_transform(int32_t p_bone) const { return skeleton_transform * bone_global_poses[p_bone]; }
+	void stage_override(int32_t p_bone, const Transform3D &p_pose, real_t p_amount) {
+		bone_overrides[p_bone] = p_pose;
+		bone_override_amounts[p_bone] = p_amount;
+	}
+	// Writes every staged override to the skeleton in one pass.
+	void commit();
+	// Turns the overrides off so the skeleton shows the animated pose.
+	void release_overrides();
 };
 
 class VRMColliderGroup : public Resource {
@@ -252,20 +456,55 @@ public:
 	// @export
 	Vector<Vector4> sphere_colliders; // DO NOT INITIALIZE HERE
 
+	// Vector4 = The local coordinate of the capsule head and the radius; the
+	// matching capsule_collider_tails entry is the local coordinate of the tail.
+	// @export
+	Vector<Vector4> capsule_colliders; // DO NOT INITIALIZE HERE
+	// @export
+	Vector<Vector3> capsule_collider_tails; // DO NOT INITIALIZE HERE
+
+	// Infinite planes in the local coordinate of the node. Joints are pushed
+	// out to the side the normal points to.
+	// @export
+	Vector<Plane> plane_colliders; // DO NOT INITIALIZE HERE
+
 	// # Only use in editor
 	// @export
 	Color gizmo_color = Color::hex(0XFF00FFFF);
 
 	// # Props
-	Vector<Ref<SphereCollider>> colliders;
+	// The group's colliders in the owner's VRMColliderTable, spheres from
+	// collider_begin, capsules from capsule_begin and planes from plane_begin.
+	uint32_t collider_begin = 0;
+	uint32_t capsule_begin = 0;
+	uint32_t plane_begin = 0;
+	uint32_t collider_end = 0;
+	// Largest distance of a local position or tail from the attachment origin.
+	real_t local_extent = 0;
+	// The attachment, resolved by _ready(): a bone of skel when bone_idx is
+	// not -1, otherwise parent itself.
 	int bone_idx = -1;
 	Node3D *parent = nullptr;
 
 	Skeleton3D *skel = nullptr;
-
-	void setup();
-	void _ready(Node3D *ready_parent, Skeleton3D *ready_skel);
-	void _process();
+	// Index of the owner's VRMSkeletonPose for skel, or -1.
+	int32_t skeleton_pose = -1;
+
+	// Sphere enclosing every collider, updated by _process().
+	Vector3 bound_center;
+	real_t bound_radius = 0;
+	// Attachment transform of the last _process(), and an upper bound of how
+	// far any collider moved with it; negative before the first _process().
+	Transform3D frame_transform;
+	real_t frame_motion = 0;
+
+	// No properties are bound, so the Resource implementation would copy nothing.
+	virtual Ref<Resource> duplicate(bool p_subresources = false) const override;
+
+	void setup(VRMColliderTable &r_colliders);
+	void _ready(Node3D *p_parent, VRMColliderTable &r_colliders);
+	// Transforms the group's colliders with the one attachment transform.
+	void _process(const VRMSkeletonPose *p_pose, VRMColliderTable &r_colliders);
 };
 
 class VRMSpringBone : public Resource {
@@ -318,23 +557,429 @@ public:
 	// @export
 	Array collider_groups; // DO NOT INITIALIZE HERE
 
+	// Joint topology of every root bone chain, baked from the skeleton's
+	// rest pose by bake_joints(): bone indices in parent first order, the
+	// parent of each joint in these arrays (-1 for chain roots), its depth
+	// in the chain and the rest position of its tail relative to the bone.
+	// They are not properties, so avatar_setup() bakes the shared source
+	// resource once and every avatar's duplicate() only shares the arrays.
+	PackedInt32Array baked_joint_bones;
+	PackedInt32Array baked_joint_parents;
+	PackedInt32Array baked_joint_depths;
+	PackedVector3Array baked_joint_tails;
+	// Hash of the names, parents and rests of the skeleton the joints were
+	// baked from, 0 if unbaked.
+	uint32_t baked_skeleton_hash = 0;
+
 	// # Props
-	Vector<Ref<VRMSpringBoneLogic>> verlets;
-	Vector<Ref<SphereCollider>> colliders;
-	Variant center;
+	// The owner's collider table and the mask of the table groups this
+	// spring bone collides with.
+	const VRMColliderTable *collider_table = nullptr;
+	LocalVector<uint64_t> collider_group_mask;
+	uint32_t collider_count = 0;
+	// Per chain collider table indices, concatenated.
+	LocalVector<uint32_t> chain_colliders;
+	// Resolved from center_bone or center_node by _ready().
+	int32_t center_bone_idx = -1;
+	ObjectID center_node_id;
 	Skeleton3D *skel = nullptr;
-
-	void setup(bool force = false);
-
-	void setup_recursive(int id, Variant center_tr);
+	// Index of the owner's VRMSkeletonPose for skel.
+	int32_t skeleton_pose = -1;
+
+	// Range of this spring bone's joints and chains in the owner's VRMSpringBoneJoints.
+	uint32_t joint_offset = 0;
+	uint32_t joint_count = 0;
+	uint32_t chain_offset = 0;
+	uint32_t chain_count = 0;
+
+	// Per frame state shared by prepare(), solve() and apply(). In fixed step
+	// mode it holds the step length rather than the frame delta.
+	bool frame_has_center = false;
+	Transform3D frame_center;
+	Transform3D frame_center_inv;
+	Quaternion frame_skeleton_rotation_inv;
+	const VRMSkeletonPose *frame_pose = nullptr;
+	real_t frame_stiffness = 0;
+	Vector3 frame_external;
+	// Bounding sphere tests run by the last prepare().
+	uint32_t frame_broadphase_tests = 0;
+	// Wakes every chain on the next prepare(), set when the parameters change.
+	bool sleep_wake = true;
+	Transform3D sleep_center;
+	// Largest collider movement since the previous prepare().
+	real_t frame_collider_motion = 0;
+
+	// Copies the authored settings. collider_groups keeps referencing the
+	// source groups, which is how the server matches them.
+	virtual Ref<Resource> duplicate(bool p_subresources = false) const override;
+
+	// Bakes the joints under root_bones from p_skeleton's rest pose.
+	// p_skeleton_hash is skeleton_bake_hash(p_skeleton), computed once by
+	// the caller for every spring bone on that skeleton.
+	void bake_joints(const Skeleton3D *p_skeleton, uint32_t p_skeleton_hash);
+	bool is_baked_for(uint32_t p_skeleton_hash) const { return baked_skeleton_hash == p_skeleton_hash; }
+	static uint32_t skeleton_bake_hash(const Skeleton3D *p_skeleton);
+
+	// Appends the baked joints to r_joints, baking them first if unbaked.
+	void setup(VRMSpringBoneJoints &r_joints);
+
+	void setup_joint(VRMSpringBoneJoints &r_joints, int id, int32_t parent_joint, const Vector3 &local_child_position);
+	// Puts the tails back at rest on the animated pose of the live skeleton,
+	// with no velocity.
+	void reset_tails(VRMSpringBoneJoints &r_joints);
+
+	Transform3D get_joint_transform(int bone_idx) const;
+
+	// Reads the center from p_pose, or from the live skeleton when null.
+	// Returns false when the spring bone simulates without a center.
+	bool get_center_transform(const VRMSkeletonPose *p_pose, Transform3D &r_transform) const;
+	void set_frame_center(bool p_has_center, const Transform3D &p_center);
 
 	// Called when the node enters the scene tree for the first time.
 	// TODO: Avoid shadowing godot methods.
-	void _ready(Skeleton3D *ready_skel, Vector<Ref<SphereCollider>> colliders_ref);
+	void _ready(Skeleton3D *ready_skel, Node3D *p_center_node, const VRMColliderTable *p_collider_table, const LocalVector<uint64_t> &p_collider_group_mask, VRMSpringBoneJoints &r_joints);
+
+	// Gathers the animated pose from p_pose and the colliders. Main thread only.
+	bool prepare(double delta, VRMSpringBoneJoints &r_joints, const VRMSkeletonPose &p_pose);
+
+	// A chain is settled while its root, its animated origins, the center and
+	// the colliders stay within p_threshold of the previous frame and its
+	// tails moved less than p_threshold in the last step. It sleeps after
+	// p_frames settled frames; 0 keeps every chain awake.
+	void update_sleep(VRMSpringBoneJoints &r_joints, int p_frames, real_t p_threshold);
+
+	// Bounds every chain around its root origin. Joints swing rigidly around
+	// their parents, so every origin stays within its reach of the chain
+	// root and every tail within length + hit radius of that.
+	void update_chain_bounds(VRMSpringBoneJoints &r_joints);
+
+	// Keeps the colliders that can touch each awake chain this frame.
+	void cull_colliders(VRMSpringBoneJoints &r_joints);
+
+	// Poses the joints [p_begin, p_end) from the solved pose of their
+	// parents, or from the animated pose for roots.
+	void pose_joints(VRMSpringBoneJoints &r_joints, uint32_t p_begin, uint32_t p_end) const;
+
+	// Runs one verlet step over the joints [p_begin, p_end) of p_chain.
+	// Specialized on whether the tails are stored relative to a center.
+	template <bool p_has_center>
+	void integrate(VRMSpringBoneJoints &r_joints, const VRMSpringBoneChain &p_chain, uint32_t p_begin, uint32_t p_end) const;
+
+	// Computes the rotations that point each joint at its tail, interpolated
+	// by p_alpha between the previous and the current simulated tail.
+	template <bool p_has_center>
+	void resolve_rotations(VRMSpringBoneJoints &r_joints, uint32_t p_begin, uint32_t p_end, real_t p_alpha) const;
+
+	// Integrates p_substeps steps, then resolves the poses of the first
+	// p_level_count levels of p_chain. Touches only the chain's joints, so
+	// chains can be solved concurrently.
+	void solve(VRMSpringBoneJoints &r_joints, const VRMSpringBoneChain &p_chain, uint32_t p_level_count, int p_substeps, real_t p_alpha) const;
+	template <bool p_has_center>
+	void solve_levels(VRMSpringBoneJoints &r_joints, const VRMSpringBoneChain &p_chain, uint32_t p_level_count, int p_substeps, real_t p_alpha) const;
+
+	// Stages the solved poses in r_pose, blended by p_amount. With
+	// p_roots_only, non-root joints go back to the animated pose.
+	void apply(const VRMSpringBoneJoints &p_joints, VRMSkeletonPose &r_pose, real_t p_amount, bool p_roots_only) const;
 
-	// Called every frame. 'delta' is the elapsed time since the previous frame.
-	// TODO: Don't shadow godot methods.
-	void _process(double delta);
+};
+
+// Owns the spring bone state of every VRMSecondary in the process, in the
+// style of the engine servers. VRMSecondary nodes register an avatar and
+// keep its RID; all registered avatars are stepped in one batched pass.
+class VRMSpringBoneServer : public Object {
+	GDCLASS(VRMSpringBoneServer, Object);
+
+	friend class VRMSpringBoneBenchmark;
+
+	static VRMSpringBoneServer *singleton;
+
+public:
+	enum SpringBoneParam {
+		SPRING_BONE_PARAM_STIFFNESS,
+		SPRING_BONE_PARAM_GRAVITY_POWER,
+		SPRING_BONE_PARAM_DRAG,
+		SPRING_BONE_PARAM_HIT_RADIUS,
+	};
+
+	enum TraceMode {
+		TRACE_NONE,
+		TRACE_RECORD,
+		TRACE_REPLAY,
+	};
+
+	// Values of the custom Performance monitors, all for the last step.
+	enum Monitor {
+		MONITOR_AVATARS,
+		MONITOR_JOINTS,
+		MONITOR_COLLIDERS,
+		MONITOR_COLLISION_PAIRS,
+		MONITOR_COLLIDER_UPDATE_USEC,
+		MONITOR_INTEGRATION_USEC,
+		MONITOR_WRITE_BACK_USEC,
+		MONITOR_GIZMO_DRAW_USEC,
+		MONITOR_SLEEPING_CHAINS,
+		MONITOR_INTERACTION_COLLIDERS,
+		MONITOR_MAX,
+	};
+
+	struct Avatar {
+		VRMSpringBoneJoints joints;
+		Vector<Ref<VRMSpringBone>> spring_bones;
+		Vector<Ref<VRMColliderGroup>> collider_groups;
+		VRMColliderTable colliders;
+		// Tails as of the last write back, without the center. Safe to read
+		// on the main thread while an async solve is running.
+		VRMPackedVector3s written_tails;
+		LocalVector<VRMSkeletonPose> skeleton_poses;
+		// Hash of the storage of the buffers a step fills, changes when one
+		// of them grows.
+		uint32_t storage_hash = 0;
+		bool active = false;
+		bool physics_process = false;
+		VRMTopLevel::SpringBoneUpdateMode update_mode = VRMTopLevel::SPRING_BONE_UPDATE_SERIAL;
+		int parallel_min_joints = 128;
+		// Fixed step mode, disabled when fixed_step_rate is 0.
+		int fixed_step_rate = 0;
+		int max_substeps = 4;
+		double step_accumulator = 0.0;
+		// Steps to run and interpolation weight for the current frame.
+		int frame_substeps = 1;
+		real_t frame_alpha = 1.0;
+		VRMTopLevel::SpringBoneLOD lod = VRMTopLevel::SPRING_BONE_LOD_FULL;
+		uint32_t lod_frame = 0;
+		// Frame time skipped by the reduced rate tiers, added to the next step.
+		double lod_skipped_delta = 0.0;
+		// Weight of the simulated pose, ramps up after leaving a coarse tier.
+		real_t lod_blend = 1.0;
+		real_t lod_blend_time = 0.25;
+		// Chains sleep after sleep_frames settled frames, 0 disables sleeping.
+		int sleep_frames = 0;
+		real_t sleep_threshold = 0.0005;
+		// Pose input trace being written or replayed, and the replay output.
+		TraceMode trace_mode = TRACE_NONE;
+		// Tier requested while tracing, applied when the trace ends.
+		VRMTopLevel::SpringBoneLOD trace_lod = VRMTopLevel::SPRING_BONE_LOD_FULL;
+		Ref<FileAccess> trace;
+		Ref<FileAccess> trace_output;
+		// Collides with the other interacting avatars of its process mode.
+		// interaction_space maps the skeletons' parent space to the scene's.
+		bool interaction = false;
+		Transform3D interaction_space;
+		Transform3D interaction_space_inv;
+		real_t interaction_scale = 1.0;
+	};
+
+private:
+	// One chain of one avatar, an element of the parallel group task.
+	struct StepChain {
+		Avatar *avatar = nullptr;
+		uint32_t chain = 0;
+	};
+
+	// Chains of the async avatars of one process mode, solving on the worker
+	// pool from the poses captured by the step that started them.
+	struct AsyncStep {
+		LocalVector<Avatar *> avatars;
+		LocalVector<StepChain> chains;
+		WorkerThreadPool::GroupID group = -1;
+		bool pending = false;
+	};
+
+	// A collider of an interacting avatar in scene space. stamp marks the
+	// avatar that last copied it, so each avatar copies it once.
+	struct InteractionCollider {
+		Vector3 position;
+		Vector3 tail;
+		real_t radius = 0;
+		VRMColliderTable::Shape shape = VRMColliderTable::SHAPE_SPHERE;
+		const Avatar *avatar = nullptr;
+		uint32_t stamp = 0;
+	};
+
+	// One grid cell overlapped by a collider. Sorted by key, the colliders
+	// of each cell are contiguous.
+	struct InteractionCell {
+		uint64_t key = 0;
+		uint32_t collider = 0;
+		bool operator<(const InteractionCell &p_other) const { return key < p_other.key; }
+	};
+
+	mutable RID_PtrOwner<Avatar, true> avatar_owner;
+	LocalVector<Avatar *> avatars;
+	LocalVector<Avatar *> step_avatars;
+	LocalVector<StepChain> step_chains;
+	// Indexed by physics_process.
+	AsyncStep async_steps[2];
+	// Avatars of this step that have work, between prepare and dispatch.
+	LocalVector<Avatar *> prepared_avatars;
+	// Uniform grid over the colliders of the interacting avatars, rebuilt
+	// every step. Colliders spanning more than a few cells skip the grid
+	// and go to interaction_large_colliders, tested by every query.
+	LocalVector<InteractionCollider> interaction_colliders;
+	LocalVector<InteractionCell> interaction_cells;
+	LocalVector<uint32_t> interaction_large_colliders;
+	static const uint32_t INTERACTION_MAX_CELLS = 64;
+	real_t interaction_cell_size = 0.5;
+	uint32_t interaction_stamp = 0;
+	// Other avatars' colliders copied into the tables in the last step.
+	uint32_t interaction_collider_count = 0;
+	uint64_t last_process_frame = UINT64_MAX;
+	uint64_t last_physics_frame = UINT64_MAX;
+	uint32_t pose_query_count = 0;
+	uint32_t broadphase_test_count = 0;
+	// Joint against collider tests in the last step, and how many there
+	// would have been without the broadphase.
+	uint64_t collision_pair_count = 0;
+	uint64_t collision_pair_count_unculled = 0;
+	uint32_t sleeping_chain_count = 0;
+	uint32_t frame_avatar_count = 0;
+	uint32_t frame_joint_count = 0;
+	uint32_t frame_collider_count = 0;
+	uint64_t collider_update_usec = 0;
+	uint64_t integration_usec = 0;
+	uint64_t write_back_usec = 0;
+	// Summed by every gizmo drawn since the last step.
+	uint64_t gizmo_draw_usec = 0;
+	bool monitors_registered = false;
+	// Hot path buffers that had to grow during the last step, the server's
+	// scratch lists plus each avatar's colliders, chain collider lists and
+	// skeleton poses. Zero once warmed up unless avatars were added or set
+	// up again. Other heap allocations of the frame are not counted.
+	uint32_t frame_buffer_growth_count = 0;
+	bool setup_since_step = false;
+
+	static int32_t _get_skeleton_pose(Avatar *p_avatar, Skeleton3D *p_skeleton);
+	static uint32_t _get_avatar_storage_hash(const Avatar *p_avatar);
+	// Steps unconditionally; step() adds the once per frame check.
+	void _step(double p_delta, bool p_physics_process);
+
+	static void _set_lod(Avatar *p_avatar, VRMTopLevel::SpringBoneLOD p_lod);
+	static void _end_trace(Avatar *p_avatar);
+	static void _store_trace_layout(Avatar *p_avatar);
+	static Error _load_trace_layout(Avatar *p_avatar);
+	// Writes or reads the delta and skeleton poses of one frame.
+	static void _store_trace_frame(Avatar *p_avatar, double p_delta);
+	static bool _load_trace_frame(Avatar *p_avatar, double &r_delta);
+	static void _store_trace_centers(Avatar *p_avatar);
+	static void _load_trace_centers(Avatar *p_avatar);
+	static void _update_interaction_space(Avatar *p_avatar);
+	void _build_interaction_grid();
+	Vector3i _interaction_cell(const Vector3 &p_point) const;
+	static uint64_t _interaction_cell_key(int32_t p_x, int32_t p_y, int32_t p_z);
+	void _add_interaction_collider(Avatar *p_avatar, VRMSpringBoneChain &r_chain, uint32_t p_collider, const Vector3 &p_center, real_t p_radius);
+	// Copies the colliders of other avatars near each chain into the
+	// avatar's collider table and flags those chains.
+	void _gather_interaction_colliders(Avatar *p_avatar);
+	static void _solve_avatar_chain(Avatar *p_avatar, uint32_t p_chain);
+	static void _solve_chain(void *p_chains, uint32_t p_index);
+	// Stages and commits the solved poses of the avatar.
+	static void _write_back(Avatar *p_avatar);
+	static void _store_written_tails(Avatar *p_avatar);
+	void _finish_async_step(AsyncStep &r_async_step, bool p_write_back);
+
+protected:
+	static void _bind_methods();
+
+public:
+	static VRMSpringBoneServer *get_singleton();
+
+	RID avatar_create();
+	void avatar_free(RID p_avatar);
+	// Duplicates the spring bones and collider groups and builds the joint
+	// table. Node paths are resolved relative to p_owner.
+	void avatar_setup(RID p_avatar, Node *p_owner, const Vector<Ref<VRMSpringBone>> &p_spring_bones, const Vector<Ref<VRMColliderGroup>> &p_collider_groups);
+	void avatar_set_active(RID p_avatar, bool p_active);
+	bool avatar_is_active(RID p_avatar) const;
+	void avatar_set_physics_process(RID p_avatar, bool p_physics_process);
+	void avatar_set_update_mode(RID p_avatar, VRMTopLevel::SpringBoneUpdateMode p_mode, int p_parallel_min_joints);
+	// Steps the avatar at p_step_rate Hz, running at most p_max_substeps per
+	// frame. A rate of 0 steps once per frame with the frame delta.
+	void avatar_set_fixed_step(RID p_avatar, int p_step_rate, int p_max_substeps);
+	void avatar_set_lod(RID p_avatar, VRMTopLevel::SpringBoneLOD p_lod);
+	VRMTopLevel::SpringBoneLOD avatar_get_lod(RID p_avatar) const;
+	void avatar_set_lod_blend_time(RID p_avatar, real_t p_blend_time);
+	void avatar_set_sleep(RID p_avatar, int p_frames, real_t p_threshold);
+	// Lets the spring bones of the avatar collide with the colliders of
+	// other interacting avatars, and theirs with its colliders.
+	void avatar_set_interaction(RID p_avatar, bool p_interaction);
+	// Wakes every chain of the avatar, for callers that moved it in ways the
+	// sleep check cannot see.
+	void avatar_wake(RID p_avatar);
+	void avatar_clear_poses(RID p_avatar);
+
+	// Records the skeleton poses, center transforms and delta of every step
+	// to p_path. A replay feeds them back instead of reading the scene, so a
+	// session can be re-run deterministically; the solved tails of each frame
+	// go to p_output_path if set. Both run the avatar at full LOD.
+	Error avatar_trace_record(RID p_avatar, const String &p_path);
+	Error avatar_trace_replay(RID p_avatar, const String &p_path, const String &p_output_path = String());
+	void avatar_trace_stop(RID p_avatar);
+	TraceMode avatar_get_trace_mode(RID p_avatar) const;
+
+	int avatar_get_spring_bone_count(RID p_avatar) const;
+	void avatar_set_spring_bone_param(RID p_avatar, int p_spring_bone, SpringBoneParam p_param, real_t p_value);
+	real_t avatar_get_spring_bone_param(RID p_avatar, int p_spring_bone, SpringBoneParam p_param) const;
+	void avatar_set_spring_bone_gravity_dir(RID p_avatar, int p_spring_bone, const Vector3 &p_gravity_dir);
+	Vector3 avatar_get_spring_bone_gravity_dir(RID p_avatar, int p_spring_bone) const;
+
+	// Read only access for the gizmo. Not exposed to scripts.
+	const Avatar *avatar_get(RID p_avatar) const;
+
+	// Steps every active avatar of the given process mode, at most once per frame.
+	void step(double p_delta, bool p_physics_process);
+	// Waits for the async solves still running and writes their poses. Every
+	// call that changes an avatar syncs first.
+	void sync();
+
+	// Skeleton pose queries made by the last step().
+	int get_pose_query_count() const;
+	int get_frame_buffer_growth_count() const;
+	// Collider broadphase counters of the last step().
+	int get_broadphase_test_count() const;
+	int64_t get_collision_pair_count() const;
+	int64_t get_collision_pair_count_unculled() const;
+	int get_sleeping_chain_count() const;
+	int get_interaction_collider_count() const;
+
+	// Edge length of the interaction grid cells. About the size of a hand
+	// or head collider works best.
+	void set_interaction_cell_size(real_t p_size);
+	real_t get_interaction_cell_size() const;
+
+	double get_monitor(Monitor p_monitor) const;
+	void add_gizmo_draw_time(uint64_t p_usec);
+	// Adds the monitors under "VRM/" in the debugger's Monitors tab.
+	void register_monitors();
+	void unregister_monitors();
+
+	VRMSpringBoneServer();
+	~VRMSpringBoneServer();
+};
+
+VARIANT_ENUM_CAST(VRMSpringBoneServer::SpringBoneParam);
+VARIANT_ENUM_CAST(VRMSpringBoneServer::TraceMode);
+VARIANT_ENUM_CAST(VRMSpringBoneServer::Monitor);
+
+// Steps synthetic avatars through VRMSpringBoneServer and reports the cost,
+// for tracking solver performance across versions. Runs without a scene
+// tree, e.g. from a script passed to `godot --headless -s`.
+class VRMSpringBoneBenchmark : public RefCounted {
+	GDCLASS(VRMSpringBoneBenchmark, RefCounted);
+
+	static void _build_avatar(Node3D *p_root, int p_chain_count, int p_chain_depth, int p_collider_count, bool p_center, Vector<Ref<VRMSpringBone>> &r_spring_bones, Vector<Ref<VRMColliderGroup>> &r_collider_groups);
+
+protected:
+	static void _bind_methods();
+
+public:
+	// Recognized parameters, all optional: avatars, chains, chain_depth,
+	// colliders, frames, warmup_frames, update_mode, parallel_min_joints,
+	// fixed_step_rate, sleep_frames, idle_percent, center, interaction and
+	// spacing. center runs the chains relative to their root bone, to
+	// compare both solver paths. interaction lets the avatars collide with
+	// each other, standing spacing meters apart in a row.
+	Dictionary run(const Dictionary &p_params);
+	String run_json(const Dictionary &p_params);
 };
 
 class SecondaryGizmo;
@@ -352,23 +997,74 @@ public:
 	bool update_in_editor = false;
 
 private:
-	Vector<Ref<VRMSpringBone>> spring_bones_internal;
-	Vector<Ref<VRMColliderGroup>> collider_groups_internal;
+	// Handle of this node's state in VRMSpringBoneServer.
+	RID avatar;
 	SecondaryGizmo *secondary_gizmo = nullptr;
 
+	bool spring_bone_lod_enabled = false;
+	Vector4 spring_bone_lod_distances;
+	real_t spring_bone_lod_hysteresis = 0.0;
+	ObjectID spring_bone_lod_visibility_notifier;
+	VRMTopLevel::SpringBoneLOD spring_bone_lod = VRMTopLevel::SPRING_BONE_LOD_FULL;
+
+	void _update_spring_bone_lod();
+
+	void _update_spring_bones(double p_delta, bool p_physics_process);
+
 protected:
 	void _notification(int p_what);
+	static void _bind_methods();
 
 public:
 	bool check_for_editor_update();
+
+	// Pose input traces, see VRMSpringBoneServer::avatar_trace_record().
+	Error start_trace_recording(const String &p_path);
+	Error start_trace_replay(const String &p_path, const String &p_output_path = String());
+	void stop_trace();
+	bool is_trace_replaying() const;
 };
 
+class Camera3D;
+
+// Draws wire spheres as instances of one unit sphere mesh and every other
+// shape into a single line surface, each uploaded once per redraw.
 class SecondaryGizmo : public MeshInstance3D {
 	GDCLASS(SecondaryGizmo, MeshInstance3D);
 
 	VRMSecondary *secondary_node = nullptr;
 	Ref<StandardMaterial3D> m = memnew(StandardMaterial3D);
 
+	MultiMeshInstance3D *sphere_instances = nullptr;
+	Ref<MultiMesh> sphere_multimesh;
+	// 12 transform and 4 color floats per sphere, the MultiMesh buffer layout.
+	Vector<float> sphere_buffer;
+	int sphere_count = 0;
+	PackedVector3Array line_vertices;
+	PackedColorArray line_colors;
+
+	// Frustums of the cameras showing the gizmo in its local space, six
+	// planes each. Shapes outside all of them are not drawn; with no camera
+	// everything is.
+	LocalVector<Plane> frustum_planes;
+	// State of the last redraw, for the redraw throttle.
+	bool redraw_drawn = false;
+	uint64_t redraw_usec = 0;
+	LocalVector<Plane> redraw_frustum_planes;
+	LocalVector<Vector3> redraw_points;
+	// Poses and tails of the chain being drawn.
+	LocalVector<Transform3D> chain_poses;
+	LocalVector<Vector3> chain_tails;
+
+	static Ref<ArrayMesh> _create_unit_sphere();
+	void _add_camera_frustum(const Camera3D *p_camera);
+	void _update_frustum();
+	bool _is_visible(const Vector3 &p_center, real_t p_radius) const;
+	bool _needs_redraw(VRMTopLevel *p_vrm_top_level, bool p_draw);
+	void _redraw(VRMTopLevel *p_vrm_top_level, bool p_draw);
+	void _begin_draw();
+	void _end_draw();
+
 public:
 	SecondaryGizmo(Node *p_parent);
 
@@ -379,6 +1075,10 @@ public:
 	void draw_line(Vector3 begin_pos, Vector3 end_pos, Color color);
 
 	void draw_sphere(Basis bas, Vector3 center, float radius, Color color);
+
+	void draw_capsule(Basis bas, Vector3 head, Vector3 tail, float radius, Color color);
+
+	void draw_plane(Basis bas, Vector3 center, Vector3 normal, float size, Color color);
 	void draw_in_editor(bool p_do_draw_spring_bones = false);
 
 	void draw_in_game();
@@ -481,6 +1181,7 @@ public:
 
 	AnimationPlayer *_create_animation_player(AnimationPlayer *animplayer, Dictionary vrm_extension, Ref<GLTFState> gstate, Dictionary human_bone_to_idx, TypedArray<Basis> pose_diffs);
 
+	static Vector3 _parse_collider_vector(const Variant &p_value);
 	void _parse_secondary_node(Node *secondary_node, Dictionary vrm_extension, Ref<GLTFState> gstate, TypedArray<Basis> pose_diffs, bool is_vrm_0);
 	void _add_joints_recursive(Dictionary &new_joints_set, Array gltf_nodes, int bone, bool include_child_meshes = false);
 